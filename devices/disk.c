@@ -84,7 +84,7 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -216,7 +216,7 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
+	select_sector (d, sec_no, 1);
 	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
 	sema_down (&c->completion_wait);
 	if (!wait_while_busy (d))
@@ -240,7 +240,7 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
+	select_sector (d, sec_no, 1);
 	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
 	if (!wait_while_busy (d))
 		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
@@ -250,6 +250,111 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 	lock_release (&c->lock);
 }
 
+/* Most sectors one READ/WRITE SECTOR command can move.  A count
+   of 0 in the sector count register means 256. */
+#define MAX_XFER_SECTORS 256
+
+/* Returns the address of the next sector of the transfer described
+   by IOV, where *V and *S are the current vector and the sector
+   within it, and advances them. */
+static uint8_t *
+iov_next_sector (const struct disk_iovec *iov, size_t *v, size_t *s) {
+	uint8_t *sector = (uint8_t *) iov[*v].buf + *s * DISK_SECTOR_SIZE;
+	if (++*s == iov[*v].sec_cnt) {
+		++*v;
+		*s = 0;
+	}
+	return sector;
+}
+
+/* Returns the total number of sectors in the IOV_CNT vectors of
+   IOV. */
+static size_t
+iov_sectors (const struct disk_iovec *iov, size_t iov_cnt) {
+	size_t total = 0;
+	for (size_t i = 0; i < iov_cnt; i++)
+		total += iov[i].sec_cnt;
+	return total;
+}
+
+/* Reads consecutive sectors from disk D, starting at SEC_NO, into
+   the IOV_CNT buffers of IOV, filling each with IOV[i].sec_cnt
+   sectors in turn.  Unlike a loop over disk_read(), this issues
+   one command per MAX_XFER_SECTORS sectors, so the disk streams
+   the whole run instead of handling a command per sector.
+   Internally synchronizes accesses to disks. */
+void
+disk_readv (struct disk *d, disk_sector_t sec_no,
+		const struct disk_iovec *iov, size_t iov_cnt) {
+	size_t left = iov_sectors (iov, iov_cnt);
+	size_t v = 0, s = 0;
+	struct channel *c;
+
+	ASSERT (d != NULL);
+	ASSERT (iov != NULL || left == 0);
+
+	c = d->channel;
+	lock_acquire (&c->lock);
+	while (left > 0) {
+		size_t cnt = left < MAX_XFER_SECTORS ? left : MAX_XFER_SECTORS;
+
+		select_sector (d, sec_no, cnt);
+		issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+		for (size_t i = 0; i < cnt; i++) {
+			/* The disk interrupts once per sector ready. */
+			sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name,
+						(disk_sector_t) (sec_no + i));
+			input_sector (c, iov_next_sector (iov, &v, &s));
+		}
+		d->read_cnt += cnt;
+		sec_no += cnt;
+		left -= cnt;
+	}
+	lock_release (&c->lock);
+}
+
+/* Writes the IOV_CNT buffers of IOV, IOV[i].sec_cnt sectors each,
+   to consecutive sectors of disk D starting at SEC_NO, with as few
+   commands as disk_readv().  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks. */
+void
+disk_writev (struct disk *d, disk_sector_t sec_no,
+		const struct disk_iovec *iov, size_t iov_cnt) {
+	size_t left = iov_sectors (iov, iov_cnt);
+	size_t v = 0, s = 0;
+	struct channel *c;
+
+	ASSERT (d != NULL);
+	ASSERT (iov != NULL || left == 0);
+
+	c = d->channel;
+	lock_acquire (&c->lock);
+	while (left > 0) {
+		size_t cnt = left < MAX_XFER_SECTORS ? left : MAX_XFER_SECTORS;
+
+		select_sector (d, sec_no, cnt);
+		issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+		for (size_t i = 0; i < cnt; i++) {
+			/* The first sector is wanted right away; each later
+			   one is asked for with an interrupt. */
+			if (i > 0)
+				sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name,
+						(disk_sector_t) (sec_no + i));
+			output_sector (c, iov_next_sector (iov, &v, &s));
+		}
+		sema_down (&c->completion_wait);
+		d->write_cnt += cnt;
+		sec_no += cnt;
+		left -= cnt;
+	}
+	lock_release (&c->lock);
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -402,17 +507,18 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt >= 1 && cnt <= MAX_XFER_SECTORS);
+	ASSERT (sec_no + cnt <= d->capacity);
+	ASSERT (sec_no + cnt <= (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt == MAX_XFER_SECTORS ? 0 : cnt);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
@@ -86,6 +86,17 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
 	return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Reads the sectors described by the IOV_CNT buffers of IOV from
+ * FILE, starting at offset FILE_OFS, which must be sector-aligned,
+ * in one disk transfer.  Returns false, reading nothing, if that
+ * goes past the end of the file's last sector.
+ * The file's current position is unaffected. */
+bool
+file_readv_at (struct file *file, const struct disk_iovec *iov,
+		size_t iov_cnt, off_t file_ofs) {
+	return inode_readv_at (file->inode, iov, iov_cnt, file_ofs);
+}
+
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at the file's current position.
  * Returns the number of bytes actually written,
@@ -113,6 +124,17 @@ file_write_at (struct file *file, const void *buffer, off_t size,
 	return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Writes the sectors described by the IOV_CNT buffers of IOV into
+ * FILE, starting at offset FILE_OFS, which must be sector-aligned,
+ * in one disk transfer.  Returns false, writing nothing, if that
+ * goes past the end of the file's last sector.
+ * The file's current position is unaffected. */
+bool
+file_writev_at (struct file *file, const struct disk_iovec *iov,
+		size_t iov_cnt, off_t file_ofs) {
+	return inode_writev_at (file->inode, iov, iov_cnt, file_ofs);
+}
+
 /* Prevents write operations on FILE's underlying inode
  * until file_allow_write() is called or FILE is closed. */
 void
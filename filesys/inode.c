@@ -115,7 +115,7 @@ inode_open (disk_sector_t sector) {
 	}
 
 	/* Allocate memory. */
-	inode = malloc (sizeof *inode);
+	inode = malloc_tagged (sizeof *inode, MT_FILESYS);
 	if (inode == NULL)
 		return NULL;
 
@@ -225,6 +225,29 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	return bytes_read;
 }
 
+/* Reads from INODE, starting at OFFSET, which must be a multiple
+ * of DISK_SECTOR_SIZE, the sectors described by the IOV_CNT
+ * buffers of IOV, in one disk transfer.  The data of an inode is
+ * contiguous on disk, so no bounce buffer or per-sector command is
+ * needed.  Returns false, reading nothing, if the sectors do not
+ * all belong to INODE. */
+bool
+inode_readv_at (struct inode *inode, const struct disk_iovec *iov,
+		size_t iov_cnt, off_t offset) {
+	size_t sec_cnt = 0;
+
+	ASSERT (offset % DISK_SECTOR_SIZE == 0);
+
+	for (size_t i = 0; i < iov_cnt; i++)
+		sec_cnt += iov[i].sec_cnt;
+	if (offset < 0 || sec_cnt == 0
+			|| offset / DISK_SECTOR_SIZE + sec_cnt
+				> bytes_to_sectors (inode_length (inode)))
+		return false;
+	disk_readv (filesys_disk, byte_to_sector (inode, offset), iov, iov_cnt);
+	return true;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
  * less than SIZE if end of file is reached or an error occurs.
@@ -287,6 +310,28 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	return bytes_written;
 }
 
+/* Writes to INODE, starting at OFFSET, which must be a multiple
+ * of DISK_SECTOR_SIZE, the sectors described by the IOV_CNT
+ * buffers of IOV, in one disk transfer; see inode_readv_at().
+ * Returns false, writing nothing, if the sectors do not all belong
+ * to INODE or writes to INODE are denied. */
+bool
+inode_writev_at (struct inode *inode, const struct disk_iovec *iov,
+		size_t iov_cnt, off_t offset) {
+	size_t sec_cnt = 0;
+
+	ASSERT (offset % DISK_SECTOR_SIZE == 0);
+
+	for (size_t i = 0; i < iov_cnt; i++)
+		sec_cnt += iov[i].sec_cnt;
+	if (inode->deny_write_cnt || offset < 0 || sec_cnt == 0
+			|| offset / DISK_SECTOR_SIZE + sec_cnt
+				> bytes_to_sectors (inode_length (inode)))
+		return false;
+	disk_writev (filesys_disk, byte_to_sector (inode, offset), iov, iov_cnt);
+	return true;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 	void
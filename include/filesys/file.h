@@ -1,9 +1,12 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
 
 struct inode;
+struct disk_iovec;
 
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
@@ -15,8 +18,12 @@ struct inode *file_get_inode (struct file *);
 /* Reading and writing. */
 off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
+bool file_readv_at (struct file *, const struct disk_iovec *,
+		size_t iov_cnt, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+bool file_writev_at (struct file *, const struct disk_iovec *,
+		size_t iov_cnt, off_t start);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
@@ -15,7 +15,11 @@ disk_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+bool inode_readv_at (struct inode *, const struct disk_iovec *,
+		size_t iov_cnt, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+bool inode_writev_at (struct inode *, const struct disk_iovec *,
+		size_t iov_cnt, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
@@ -0,0 +1,21 @@
+#ifndef __LIB_MMAN_H
+#define __LIB_MMAN_H
+
+/* Memory-mapping constants shared by the kernel and user programs. */
+
+/* Flag that may be or'd into the WRITABLE argument of mmap(). */
+#define MAP_POPULATE 0x2        /* Load every page before returning. */
+
+/* Advice for madvise(). */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Random access: no read-ahead. */
+#define MADV_SEQUENTIAL 2       /* Sequential access: read far ahead
+                                   and drop pages left behind. */
+#define MADV_WILLNEED 3         /* Load the range now. */
+#define MADV_DONTNEED 4         /* Free the range's frames now. */
+
+/* Flags for msync(). */
+#define MS_ASYNC 1              /* Start writing back, do not wait. */
+#define MS_SYNC 4               /* Write back before returning. */
+
+#endif /* lib/mman.h */
@@ -36,6 +36,11 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra for Project 3 */
+	SYS_MADVISE,                /* Advise on use of a memory range. */
+	SYS_MSYNC,                  /* Write back a memory mapping. */
+	SYS_RSSLIMIT,               /* Limit the resident set. */
 };
 
 #endif /* lib/syscall-nr.h */
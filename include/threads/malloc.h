@@ -4,10 +4,26 @@
 #include <debug.h>
 #include <stddef.h>
 
+/* Subsystems that kernel allocations are charged to. */
+enum malloc_tag {
+	MT_MISC,                    /* Plain malloc() callers. */
+	MT_LOADER,                  /* ELF loader (lazy_load_arg). */
+	MT_VM_PAGE,                 /* struct page and the SPT. */
+	MT_VM_FRAME,                /* Frame table. */
+	MT_VM_SWAP,                 /* Swap bookkeeping. */
+	MT_MMAP,                    /* Memory-mapped files. */
+	MT_FILESYS,                 /* Inodes and open files. */
+	MT_CNT                      /* Number of tags. */
+};
+
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
+void *malloc_tagged (size_t, enum malloc_tag) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
 
+void malloc_print_stats (void);
+void malloc_check_leaks (const char *who, int tid);
+
 #endif /* threads/malloc.h */
@@ -3,27 +3,55 @@
 #define THREAD_MMU_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "threads/pte.h"
 
 typedef bool pte_for_each_func(uint64_t *pte, void *va, void *aux);
 
 uint64_t *pml4e_walk(uint64_t *pml4, const uint64_t va, int create);
+uint64_t *pml4e_walk_pde(uint64_t *pml4, const uint64_t va, int create);
 uint64_t *pml4_create(void);
 bool pml4_for_each(uint64_t *, pte_for_each_func *, void *);
 void pml4_destroy(uint64_t *pml4);
 void pml4_activate(uint64_t *pml4);
+void pml4_pcid_init(void);
 void *pml4_get_page(uint64_t *pml4, const void *upage);
 bool pml4_set_page(uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_set_huge_page(uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_set_range(uint64_t *pml4, void *upage, void *kpage, size_t size,
+					bool rw);
+bool pml4_split_huge_page(uint64_t *pml4, void *upage);
 void pml4_clear_page(uint64_t *pml4, void *upage);
+
+/* Batched TLB invalidation for unmapping many pages at once.
+ * See tlb_gather_finish(). */
+#define TLB_GATHER_MAX 32	 /* Pages invalidated one by one. */
+#define TLB_GATHER_TABLES 16 /* Page tables that may be freed. */
+struct tlb_gather
+{
+	uint64_t *pml4;						/* Address space being unmapped. */
+	bool fullmm;						/* Whole address space going away. */
+	bool flush_all;						/* Too many pages: flush everything. */
+	size_t va_cnt;						/* Number of entries in VAS. */
+	uint64_t vas[TLB_GATHER_MAX];		/* Pages to invalidate. */
+	size_t table_cnt;					/* Number of entries in TABLES. */
+	uint64_t tables[TLB_GATHER_TABLES]; /* An address in each touched table. */
+};
+
+void tlb_gather_init(struct tlb_gather *, uint64_t *pml4, bool fullmm);
+void pml4_clear_page_gather(struct tlb_gather *, void *upage);
+void tlb_gather_finish(struct tlb_gather *);
 bool pml4_is_dirty(uint64_t *pml4, const void *upage);
 void pml4_set_dirty(uint64_t *pml4, const void *upage, bool dirty);
 bool pml4_is_accessed(uint64_t *pml4, const void *upage);
 void pml4_set_accessed(uint64_t *pml4, const void *upage, bool accessed);
+void pml4_set_writable(uint64_t *pml4, const void *upage, bool writable);
 
 #define is_writable(pte) (*(pte)&PTE_W)
 #define is_user_pte(pte) (*(pte)&PTE_U)
 #define is_kern_pte(pte) (!is_user_pte(pte))
+#define is_huge_pte(pte) (*(pte)&PTE_PS)
 
 #define pte_get_paddr(pte) (pg_round_down(*(pte)))
 
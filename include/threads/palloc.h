@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -17,7 +18,15 @@ extern size_t user_page_limit;
 uint64_t palloc_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_multiple_aligned (enum palloc_flags, size_t page_cnt,
+		size_t align);
+bool palloc_grow_multiple (void *, size_t old_cnt, size_t new_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_set_tag (void *, size_t page_cnt, uint8_t tag);
+uint8_t palloc_get_tag (const void *);
+void *palloc_user_pool (size_t *page_cnt);
+size_t palloc_user_free_cnt (void);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
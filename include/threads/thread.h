@@ -97,6 +97,9 @@ struct thread
 	char name[16];			   /* Name (for debugging purposes). */
 	int priority;			   /* Priority. */
 	int64_t wakeup_ticks;	   // 깨어날 tick
+	struct list_elem sleep_elem; /* Element in the sleep list. */
+	bool timed_wait;		   /* Also on a semaphore wait list, by
+								  sema_down_timeout(). */
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem; /* List element. */
@@ -128,6 +131,13 @@ struct thread
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
 	struct supplemental_page_table spt;
+
+	/* Owned by vm/vm.c, protected by its frame table lock. */
+	size_t rss;                 /* Resident pages. */
+	size_t rss_soft, rss_hard;  /* Limits on RSS in pages, 0 if none. */
+	int64_t thrash_until;       /* Held back from running until then. */
+	struct list_elem rss_elem;  /* Element in the list of processes
+	                               with resident pages. */
 #endif
 
 	/* Owned by thread.c. */
@@ -160,6 +170,8 @@ void thread_exit(void) NO_RETURN;
 void thread_yield(void);
 void thread_sleep(int64_t ticks);
 void thread_wakeup(int64_t current_ticks);
+void thread_block_until(int64_t ticks);
+void thread_cancel_timeout(struct thread *);
 bool cmp_thread_ticks(const struct list_elem *a, const struct list_elem *b, void *aux);
 
 int thread_get_priority(void);
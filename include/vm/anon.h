@@ -2,12 +2,27 @@
 #define VM_ANON_H
 #include "vm/vm.h"
 struct page;
+struct frame;
+struct zswap_entry;
 enum vm_type;
 
 struct anon_page {
+	size_t slot;        /* Swap slot holding the page, if swapped out. */
+	bool readahead;     /* Read ahead into a frame, not yet faulted. */
+	struct zswap_entry *zentry; /* Compressed copy, if swapped out to zswap. */
 };
 
+/* Most anonymous pages written out in one swap transfer. */
+#define SWAP_CLUSTER 16
+
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+bool anon_swap_out_cluster (struct page *pages[], size_t cnt);
+bool anon_has_swap_copy (struct page *page);
+bool anon_mergeable (struct page *page);
+bool anon_fork (struct page *dst, struct page *src);
+bool anon_swap_write (const void *buf, size_t *slot);
+void anon_swap_attach (struct page *page, size_t slot);
+bool anon_swap_out_shared (struct frame *frame);
 
 #endif
@@ -11,10 +11,31 @@ struct file_page {
 	off_t file_ofs;
 	off_t read_bytes;/** type 확실치 않음 */
 	off_t zero_bytes;
+	bool shared;        /* May share its frame; see VM_FILE_SHARED. */
+	bool private;       /* Copy-on-write; see VM_FILE_PRIVATE. */
 };
 
+/* Marks a read-only page of a file that cannot change while it is
+ * mapped, such as executable text, whose frame may be shared
+ * through the page cache with other processes mapping the same
+ * block. */
+#define VM_FILE_SHARED VM_MARKER_0
+
+/* Marks a page of a private file mapping, such as the initialized
+ * data of an executable: loaded from the file and mapped read-only,
+ * so that while clean it may share a frame through the page cache
+ * and is dropped on eviction, and turned into an anonymous page by
+ * its first write, which is never written back to the file. */
+#define VM_FILE_PRIVATE VM_MARKER_1
+
+/* Most pages file_backed_writeback() takes at once. */
+#define FILE_WB_MAX 16
+
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
+bool file_backed_dirty (struct page *page);
+bool file_backed_private (struct page *page);
+void file_backed_writeback (struct page *pages[], size_t cnt);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
@@ -5,6 +5,7 @@
 #include "threads/mmu.h"
 #include "lib/string.h"
 #include "lib/kernel/hash.h"
+#include "lib/kernel/list.h"
 
 enum vm_type {
 	/* page not initialized */
@@ -30,6 +31,7 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/vma.h"
 #include "lib/kernel/hash.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
@@ -37,6 +39,7 @@ enum vm_type {
 
 struct page_operations;
 struct thread;
+struct spt_node;
 
 #define VM_TYPE(type) ((type) & 7)
 
@@ -50,9 +53,10 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
-	struct hash_elem hash_elem;
 	bool writable;
-	off_t page_cnt;
+	struct thread *owner;       /* Thread whose page table maps the page. */
+	struct list_elem rmap_elem; /* Element in frame's PAGES. */
+	bool faulted_around;        /* Mapped by fault-around, not yet seen used. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -66,26 +70,33 @@ struct page {
 	};
 };
 
-struct slot {
-	struct page *page;
-	struct list_elem swap_elem;
-	int slot_number;
-};
-
-/* The representation of "frame" */
+/* The representation of "frame".
+ * There is one for every page of the user pool, kept in an array
+ * indexed by physical frame number; see vm.c.  Normally a frame
+ * holds one page, but after fork() an anonymous frame is shared
+ * copy-on-write by the parent's and the child's page, and KSM
+ * shares one among pages found to hold the same contents. */
 struct frame {
 	void *kva;
-	struct page *page;
-	/* list_elem으로 frame_elem을 추가 */
-	struct list_elem frame_elem;
+	struct list pages;     /* Pages held (reverse map), empty if free. */
+	size_t ref_cnt;        /* Length of PAGES. */
+	unsigned pin_cnt;      /* Pins held; not to be evicted while
+	                          nonzero, e.g. while loading. */
+	bool io;               /* Being read or written with no lock held;
+	                          see vm.c. */
+
+	/* File block held, if the frame is in the page cache. */
+	struct inode *inode;   /* NULL if not. */
+	off_t ofs;
+	uint32_t read_bytes;
+	struct hash_elem cache_elem;
+
+	/* Same-page merging; see vm.c. */
+	uint32_t ksm_sum;      /* Checksum when KSM last looked. */
+	bool ksm;              /* Shared by KSM, in the stable table. */
+	struct hash_elem ksm_elem;
 };
 
-/* swap_table과 frame_table을 전역으로 선언 */
-struct list swap_table;
-struct list frame_table;
-
-struct lock swap_lock;
-struct lock frame_lock;
 
 /* The function table for page operations.
  * This is one way of implementing "interface" in C.
@@ -107,7 +118,8 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
-	struct hash pages;
+	struct spt_node *root; /* Radix tree of pages by page number. */
+	struct vma *vmas;      /* Tree of VMAs by address; see vma.c. */
 };
 
 #include "threads/thread.h"
@@ -117,9 +129,19 @@ bool supplemental_page_table_copy (struct supplemental_page_table *dst,
 void supplemental_page_table_kill (struct supplemental_page_table *spt);
 struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
+struct page *spt_next_page (struct supplemental_page_table *spt,
+		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
 
+/* Set false by the -no-thp boot option to disable transparent huge
+ * pages. */
+extern bool thp_enabled;
+
+/* Frames the KSM daemon scans per round, set by the -ksm boot
+ * option; 0 disables same-page merging. */
+extern size_t ksm_pages_to_scan;
+
 void vm_init (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
@@ -130,6 +152,16 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+bool do_madvise (void *addr, size_t length, int advice);
+bool do_msync (void *addr, size_t length, int flags);
+bool do_rsslimit (size_t soft, size_t hard);
+void vm_free_frame (struct frame *frame);
+struct frame *vm_get_free_frame (struct page *page);
+void vm_unpin_frame (struct frame *frame);
+void vm_io_unlock (void);
+void vm_io_relock (void);
+void vm_unmap_gather (struct tlb_gather *tlb, struct page *page);
 enum vm_type page_get_type (struct page *page);
+void vm_print_stats (void);
 
 #endif  /* VM_VM_H */
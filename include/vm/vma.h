@@ -0,0 +1,44 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/vm.h"
+
+struct file;
+struct page;
+struct supplemental_page_table;
+enum vm_type;
+
+/* A virtual memory area: a run of pages mapped the same way, such
+ * as an mmap() region or a segment of the executable.  Its pages
+ * enter the supplemental page table only when first faulted. */
+struct vma {
+	void *start;            /* First page. */
+	void *end;              /* Just past the last page. */
+	enum vm_type type;      /* Type of its pages, with markers. */
+	bool writable;
+	struct file *file;      /* Backing file, owned; NULL if none. */
+	off_t ofs;              /* Offset in FILE of START. */
+	size_t read_bytes;      /* Bytes read from FILE, the rest zeros. */
+	int advice;             /* MADV_* set by madvise(). */
+
+	/* Node in the SPT's tree; see vma.c. */
+	struct vma *left, *right;
+	int height;
+};
+
+bool vma_map (struct supplemental_page_table *spt, void *start,
+		size_t length, enum vm_type type, bool writable,
+		struct file *file, off_t ofs, size_t read_bytes);
+void vma_unmap (struct supplemental_page_table *spt, struct vma *vma);
+struct vma *vma_find (struct supplemental_page_table *spt, void *va);
+bool vma_overlaps (struct supplemental_page_table *spt, void *start,
+		void *end);
+struct page *vma_get_page (struct supplemental_page_table *spt, void *va);
+int vma_advice (struct page *page);
+bool vma_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
+void vma_destroy (struct supplemental_page_table *spt);
+
+#endif
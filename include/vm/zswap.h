@@ -0,0 +1,22 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+
+struct page;
+struct zswap_entry;
+
+/* Pool limit in pages, set by the -zswap boot option; SIZE_MAX
+ * picks a default from the size of the user pool.  0 disables the
+ * compressed tier. */
+extern size_t zswap_pool_limit;
+
+void zswap_init (void);
+bool zswap_store (struct page *page, const void *kva);
+bool zswap_load (struct page *page, void *kva);
+bool zswap_dup (struct page *dst, struct page *src);
+void zswap_free (struct page *page);
+void zswap_miss (void);
+void zswap_print_stats (void);
+
+#endif
@@ -158,6 +158,21 @@ void munmap(void *addr)
 	syscall1(SYS_MUNMAP, addr);
 }
 
+int madvise(void *addr, size_t length, int advice)
+{
+	return syscall3(SYS_MADVISE, addr, length, advice);
+}
+
+int msync(void *addr, size_t length, int flags)
+{
+	return syscall3(SYS_MSYNC, addr, length, flags);
+}
+
+int rsslimit(size_t soft, size_t hard)
+{
+	return syscall2(SYS_RSSLIMIT, soft, hard);
+}
+
 bool chdir(const char *dir)
 {
 	return syscall1(SYS_CHDIR, dir);
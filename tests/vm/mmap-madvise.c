@@ -0,0 +1,57 @@
+/* Maps a file with MAP_POPULATE, gives madvise() advice for it,
+   writes to it and discards its pages with MADV_DONTNEED, then
+   checks that the data written survived, having been written back
+   to the file, and that a discarded page of BSS reads back as
+   zeros. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+static char zeros[4096];
+
+void
+test_main (void)
+{
+  static char page[4096] __attribute__ ((aligned (4096)));
+  int handle;
+  void *map;
+  char buf[1024];
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (ACTUAL, 4096, 1 | MAP_POPULATE, handle, 0)) != MAP_FAILED,
+         "mmap \"sample.txt\" with MAP_POPULATE");
+  if (memcmp (ACTUAL, sample, strlen (sample)))
+    fail ("read of populated mapping reported bad data");
+
+  CHECK (madvise (map, 4096, MADV_SEQUENTIAL) == 0, "madvise sequential");
+  CHECK (madvise (map, 4096, MADV_RANDOM) == 0, "madvise random");
+  CHECK (madvise (map, 4096, MADV_WILLNEED) == 0, "madvise willneed");
+  CHECK (madvise ((char *) map + 1, 4096, MADV_NORMAL) == -1,
+         "madvise misaligned address fails");
+  CHECK (madvise (map, 4096, 99) == -1, "madvise bad advice fails");
+
+  /* Dirty the mapping, then drop it: the data must survive. */
+  memset (ACTUAL, 'x', 16);
+  CHECK (madvise (map, 4096, MADV_DONTNEED) == 0, "madvise dontneed mapping");
+  if (memcmp (ACTUAL, "xxxxxxxxxxxxxxxx", 16)
+      || memcmp ((char *) ACTUAL + 16, sample + 16, strlen (sample) - 16))
+    fail ("mapping lost data after MADV_DONTNEED");
+  munmap (map);
+
+  seek (handle, 0);
+  read (handle, buf, strlen (sample));
+  CHECK (!memcmp (buf, "xxxxxxxxxxxxxxxx", 16), "data written back to file");
+  close (handle);
+
+  /* A page of BSS comes back zeroed. */
+  memset (page, 'y', sizeof page);
+  CHECK (madvise (page, sizeof page, MADV_DONTNEED) == 0,
+         "madvise dontneed BSS page");
+  if (memcmp (page, zeros, sizeof page))
+    fail ("BSS page not zeroed by MADV_DONTNEED");
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-madvise) begin
+(mmap-madvise) open "sample.txt"
+(mmap-madvise) mmap "sample.txt" with MAP_POPULATE
+(mmap-madvise) madvise sequential
+(mmap-madvise) madvise random
+(mmap-madvise) madvise willneed
+(mmap-madvise) madvise misaligned address fails
+(mmap-madvise) madvise bad advice fails
+(mmap-madvise) madvise dontneed mapping
+(mmap-madvise) data written back to file
+(mmap-madvise) madvise dontneed BSS page
+(mmap-madvise) end
+EOF
+pass;
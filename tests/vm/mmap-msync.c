@@ -0,0 +1,73 @@
+/* Writes to a file through a mapping, calls msync() while the
+   mapping is still in place, and verifies with the read system
+   call that the data reached the file.  Then does the same over
+   and over with MS_SYNC following right after MS_ASYNC, so that
+   it runs while the flusher is writing the same pages. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+#define PAGES 16
+#define ROUNDS 8
+
+static char page[4096];
+
+void
+test_main (void)
+{
+  int handle;
+  void *map;
+  char buf[1024];
+  int round, i;
+  size_t j;
+
+  CHECK (create ("sample.txt", strlen (sample)), "create \"sample.txt\"");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (ACTUAL, 4096, 1, handle, 0)) != MAP_FAILED, "mmap \"sample.txt\"");
+  memcpy (ACTUAL, sample, strlen (sample));
+
+  CHECK (msync (map, 4096, MS_SYNC) == 0, "msync MS_SYNC");
+  read (handle, buf, strlen (sample));
+  CHECK (!memcmp (buf, sample, strlen (sample)),
+         "compare read data against written data");
+
+  CHECK (msync (map, 4096, MS_ASYNC) == 0, "msync MS_ASYNC");
+  CHECK (msync ((char *) map + 4096, 4096, MS_SYNC) == -1,
+         "msync of unmapped range fails");
+  CHECK (msync (map, 4096, MS_SYNC | MS_ASYNC) == -1,
+         "msync with both flags fails");
+
+  munmap (map);
+  close (handle);
+
+  CHECK (create ("msync.dat", PAGES * 4096), "create \"msync.dat\"");
+  CHECK ((handle = open ("msync.dat")) > 1, "open \"msync.dat\"");
+  CHECK ((map = mmap (ACTUAL, PAGES * 4096, 1, handle, 0)) != MAP_FAILED,
+         "mmap \"msync.dat\"");
+  for (round = 0; round < ROUNDS; round++)
+    {
+      memset (map, 'a' + round, PAGES * 4096);
+      if (msync (map, PAGES * 4096, MS_ASYNC) != 0)
+        fail ("msync MS_ASYNC failed in round %d", round);
+      memset (map, 'A' + round, PAGES * 4096);
+      if (msync (map, PAGES * 4096, MS_SYNC) != 0)
+        fail ("msync MS_SYNC failed in round %d", round);
+
+      seek (handle, 0);
+      for (i = 0; i < PAGES; i++)
+        {
+          if (read (handle, page, sizeof page) != sizeof page)
+            fail ("short read of page %d in round %d", i, round);
+          for (j = 0; j < sizeof page; j++)
+            if (page[j] != 'A' + round)
+              fail ("page %d stale after MS_SYNC in round %d", i, round);
+        }
+    }
+  msg ("msync MS_SYNC under the flusher");
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-msync) begin
+(mmap-msync) create "sample.txt"
+(mmap-msync) open "sample.txt"
+(mmap-msync) mmap "sample.txt"
+(mmap-msync) msync MS_SYNC
+(mmap-msync) compare read data against written data
+(mmap-msync) msync MS_ASYNC
+(mmap-msync) msync of unmapped range fails
+(mmap-msync) msync with both flags fails
+(mmap-msync) create "msync.dat"
+(mmap-msync) open "msync.dat"
+(mmap-msync) mmap "msync.dat"
+(mmap-msync) msync MS_SYNC under the flusher
+(mmap-msync) end
+EOF
+pass;
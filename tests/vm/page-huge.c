@@ -0,0 +1,59 @@
+/* Fills 4 MB of BSS, which holds at least one whole 2 MB block
+   that the kernel may back with a huge page, then checks that
+   fork() shares it copy-on-write page by page and that
+   MADV_DONTNEED frees single pages inside it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 1024 * 1024)
+#define PAGE 4096
+
+static char buf[SIZE] __attribute__ ((aligned (PAGE)));
+
+static void
+check (size_t skip, char skip_value)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    {
+      char want = i / PAGE == skip ? skip_value : (char) (i / PAGE);
+      if (buf[i] != want)
+        fail ("byte %zu is %d, not %d", i, buf[i], want);
+    }
+}
+
+void
+test_main (void)
+{
+  size_t mid = SIZE / PAGE / 2;
+  pid_t child;
+
+  msg ("fill");
+  for (size_t i = 0; i < SIZE; i++)
+    buf[i] = i / PAGE;
+  check (mid, mid);
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      memset (buf + mid * PAGE, 'c', PAGE);
+      check (mid, 'c');
+      exit (81);
+    }
+  CHECK (wait (child) == 81, "child wrote its copy");
+  check (mid, mid);
+  msg ("parent copy unchanged");
+
+  memset (buf + mid * PAGE, 'p', PAGE);
+  check (mid, 'p');
+  msg ("parent wrote its copy");
+
+  CHECK (madvise (buf + mid * PAGE, PAGE, MADV_DONTNEED) == 0,
+         "madvise dontneed one page");
+  check (mid, 0);
+  msg ("page zeroed, rest intact");
+}
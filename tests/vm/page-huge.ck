@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-huge) begin
+(page-huge) fill
+(page-huge) child wrote its copy
+(page-huge) parent copy unchanged
+(page-huge) parent wrote its copy
+(page-huge) madvise dontneed one page
+(page-huge) page zeroed, rest intact
+(page-huge) end
+EOF
+pass;
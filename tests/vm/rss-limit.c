@@ -0,0 +1,33 @@
+/* Limits the resident set to far less than a 1 MB buffer, then
+   checks that filling the buffer still works, its pages going
+   to swap as the process reaches its hard limit. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+#define PAGE 4096
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+
+  CHECK (rsslimit (128 * PAGE, 64 * PAGE) == -1, "soft limit above hard");
+  CHECK (rsslimit (0, 4 * PAGE) == -1, "hard limit too small");
+  CHECK (rsslimit (32 * PAGE, 64 * PAGE) == 0, "limit to 64 pages");
+
+  msg ("fill");
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i / PAGE * 7 + 1;
+  msg ("check");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (char) (i / PAGE * 7 + 1))
+      fail ("byte %zu is %d", i, buf[i]);
+
+  CHECK (rsslimit (0, 0) == 0, "remove limits");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rss-limit) begin
+(rss-limit) soft limit above hard
+(rss-limit) hard limit too small
+(rss-limit) limit to 64 pages
+(rss-limit) fill
+(rss-limit) check
+(rss-limit) remove limits
+(rss-limit) end
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Forks children that each fill and check their own copy of a
+   2 MB buffer, together more than fits in memory, so that their
+   page faults and swap I/O overlap. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+#define SIZE (2 * 1024 * 1024)
+#define PAGE 4096
+
+static char buf[SIZE];
+
+static int
+fill_and_check (int id)
+{
+  size_t i;
+  int pass;
+
+  for (pass = 0; pass < 2; pass++)
+    {
+      for (i = 0; i < SIZE; i += PAGE / 4)
+        buf[i] = i / PAGE + id;
+      for (i = 0; i < SIZE; i += PAGE / 4)
+        if (buf[i] != (char) (i / PAGE + id))
+          return 1;
+    }
+  return 0;
+}
+
+void
+test_main (void)
+{
+  pid_t child[CHILD_CNT];
+  int i;
+
+  msg ("fork children");
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      child[i] = fork ("swap-par");
+      if (child[i] == 0)
+        exit (fill_and_check (i + 1));
+      if (child[i] < 0)
+        fail ("fork failed");
+    }
+  for (i = 0; i < CHILD_CNT; i++)
+    if (wait (child[i]) != 0)
+      fail ("child %d found its buffer corrupted", i);
+  msg ("children done");
+}
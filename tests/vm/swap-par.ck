@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-par) begin
+(swap-par) fork children
+(swap-par) children done
+(swap-par) end
+EOF
+pass;
@@ -31,6 +31,7 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
@@ -150,21 +151,36 @@ paging_init (uint64_t mem_end) {
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
+	uint64_t text_start = vtop (&start);
+	uint64_t text_end = vtop (&_end_kernel_text);
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	// Whole 2 MB chunks use a single huge mapping, which saves the
+	// page tables and most of the TLB misses.  Chunks that overlap
+	// the read-only kernel text or run past mem_end use 4 kB pages.
+	for (uint64_t pa = 0; pa < mem_end; ) {
 		uint64_t va = (uint64_t) ptov(pa);
 
+		if ((pa & HPGMASK) == 0 && pa + HPGSIZE <= mem_end
+				&& (pa + HPGSIZE <= text_start || text_end <= pa)) {
+			if ((pte = pml4e_walk_pde (pml4, va, 1)) != NULL)
+				*pte = pa | PTE_P | PTE_W | PTE_PS;
+			pa += HPGSIZE;
+			continue;
+		}
+
 		perm = PTE_P | PTE_W;
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
 		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
 			*pte = pa | perm;
+		pa += PGSIZE;
 	}
 
 	// reload cr3
 	pml4_activate(0);
+	pml4_pcid_init ();
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -226,6 +242,14 @@ parse_options (char **argv) {
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-zswap"))
+			zswap_pool_limit = atoi (value);
+		else if (!strcmp (name, "-ksm"))
+			ksm_pages_to_scan = atoi (value);
+		else if (!strcmp (name, "-no-thp"))
+			thp_enabled = false;
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -328,6 +352,11 @@ usage (void) {
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -zswap=COUNT       Limit compressed swap to COUNT pages (0: off).\n"
+			"  -ksm=COUNT         Scan COUNT frames per round for pages to merge (0: off).\n"
+			"  -no-thp            Do not back anonymous memory with huge pages.\n"
 #endif
 			);
 	power_off ();
@@ -343,6 +372,7 @@ power_off (void) {
 #endif
 
 	print_stats ();
+	malloc_check_leaks ("shutdown", TID_ERROR);
 
 	printf ("Powering off...\n");
 	outw (0x604, 0x2000);               /* Poweroff command for qemu */
@@ -354,6 +384,8 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	palloc_print_stats ();
+	malloc_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -362,4 +394,8 @@ print_stats (void) {
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+	zswap_print_stats ();
+#endif
 }
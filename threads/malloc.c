@@ -5,9 +5,12 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 
 /* A simple implementation of malloc().
 
@@ -28,75 +31,194 @@
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   Blocks bigger than 1 kB don't fit a single page with a
+   descriptor more than once, so a few larger size classes (see
+   big_classes) use arenas of several contiguous pages instead.
+   Such an arena is aligned to its own size, and each of its
+   pages is tagged in the page allocator with the arena's size in
+   pages, which lets block_to_arena() find its header from any
+   block inside it.
+   Anything bigger than the largest class is handled by
+   allocating contiguous pages with the page allocator and
+   sticking the allocation size at the beginning of the
+   allocated block's arena header.
+
+   realloc() resizes in place when the new size still maps to
+   the block's size class, or, for a big block, when pages can be
+   released from or claimed after its end.
+
+   Every allocation is charged to a tag (see enum malloc_tag).
+   Each tag owns its own set of descriptors, so an arena only
+   ever holds blocks of a single tag and free() can recover the
+   tag from the arena without any per-block overhead.  Per-tag
+   live/peak bytes and allocation counts, and per-size-class
+   arena usage, are printed by malloc_print_stats().
+
+   Building with MALLOC_DEBUG defined additionally prefixes every
+   block with a small header recording the requested size, the
+   allocating thread and call site, and links it into a list of
+   live allocations.  malloc_check_leaks() walks that list. */
 
 /* Descriptor. */
 struct desc {
 	size_t block_size;          /* Size of each element in bytes. */
+	size_t arena_pages;         /* Number of pages in an arena. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
 	struct list free_list;      /* List of free blocks. */
 	struct lock lock;           /* Lock. */
+	enum malloc_tag tag;        /* Tag charged for these blocks. */
+	size_t arena_cnt;           /* Number of arenas held. */
+	size_t used_cnt;            /* Number of blocks handed out. */
 };
 
+/* Per-tag accounting. */
+struct tag_stats {
+	size_t live_bytes;          /* Bytes currently charged. */
+	size_t peak_bytes;          /* High-water mark of LIVE_BYTES. */
+	size_t big_pages;           /* Pages held by big blocks. */
+	unsigned long long alloc_cnt;   /* Number of allocations. */
+	unsigned long long free_cnt;    /* Number of frees. */
+};
+
+/* Names of the tags, for malloc_print_stats(). */
+static const char *tag_names[MT_CNT] = {
+	[MT_MISC] = "misc",
+	[MT_LOADER] = "loader",
+	[MT_VM_PAGE] = "vm-page",
+	[MT_VM_FRAME] = "vm-frame",
+	[MT_VM_SWAP] = "vm-swap",
+	[MT_MMAP] = "mmap",
+	[MT_FILESYS] = "filesys",
+};
+
+/* Size classes above half a page, with the number of pages in
+   each of their arenas.  Arena sizes must be powers of 2 no
+   larger than MAX_ARENA_PAGES. */
+static const struct {
+	size_t block_size;
+	size_t arena_pages;
+} big_classes[] = {
+	{2048, 4},                  /* 7 blocks per arena. */
+	{3072, 4},                  /* 5 blocks per arena. */
+	{6144, 8},                  /* 5 blocks per arena. */
+};
+#define MAX_ARENA_PAGES 8
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
 /* Arena. */
 struct arena {
 	unsigned magic;             /* Always set to ARENA_MAGIC. */
+	enum malloc_tag tag;        /* Tag of a big block. */
 	struct desc *desc;          /* Owning descriptor, null for big block. */
 	size_t free_cnt;            /* Free blocks; pages in big block. */
 };
 
+#ifdef MALLOC_DEBUG
+/* Header in front of every block in MALLOC_DEBUG builds. */
+struct alloc_hdr {
+	struct list_elem elem;      /* Element in live_list. */
+	void *caller;               /* Return address of the allocation. */
+	size_t size;                /* Requested size. */
+	tid_t tid;                  /* Allocating thread. */
+	enum malloc_tag tag;        /* Tag charged. */
+};
+
+/* Every live allocation, protected by disabling interrupts. */
+static struct list live_list;
+#endif
+
 /* Free block. */
 struct block {
 	struct list_elem free_elem; /* Free list element. */
 };
 
-/* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
-static size_t desc_cnt;         /* Number of descriptors. */
+/* Our set of descriptors, one row per tag. */
+static struct desc descs[MT_CNT][10];   /* Descriptors. */
+static size_t desc_cnt;         /* Number of descriptors per tag. */
+static struct tag_stats tag_stats[MT_CNT];
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *do_malloc (size_t size, enum malloc_tag, void *caller);
+static struct desc *size_to_desc (enum malloc_tag, size_t size);
+static bool resize_in_place (void *block, size_t new_size);
+static void charge (enum malloc_tag, size_t bytes);
+static void uncharge (enum malloc_tag, size_t bytes);
+static void recharge (enum malloc_tag, size_t old_bytes, size_t new_bytes);
+
+/* Initializes descriptor D for TAG. */
+static void
+desc_init (struct desc *d, enum malloc_tag tag, size_t block_size,
+		size_t arena_pages) {
+	d->block_size = block_size;
+	d->arena_pages = arena_pages;
+	d->blocks_per_arena =
+		(arena_pages * PGSIZE - sizeof (struct arena)) / block_size;
+	list_init (&d->free_list);
+	lock_init (&d->lock);
+	d->tag = tag;
+}
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
-	size_t block_size;
-
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
-		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-		list_init (&d->free_list);
-		lock_init (&d->lock);
+	size_t block_size, i;
+	int tag;
+
+	for (tag = 0; tag < MT_CNT; tag++) {
+		struct desc *d = descs[tag];
+		for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+			desc_init (d++, tag, block_size, 1);
+		for (i = 0; i < sizeof big_classes / sizeof *big_classes; i++) {
+			ASSERT (big_classes[i].arena_pages <= MAX_ARENA_PAGES);
+			desc_init (d++, tag, big_classes[i].block_size,
+					big_classes[i].arena_pages);
+		}
+		desc_cnt = d - descs[tag];
+		ASSERT (desc_cnt <= sizeof descs[0] / sizeof *descs[0]);
 	}
+#ifdef MALLOC_DEBUG
+	list_init (&live_list);
+#endif
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) {
+	return do_malloc (size, MT_MISC, __builtin_return_address (0));
+}
+
+/* Like malloc(), but charges the block to TAG. */
+void *
+malloc_tagged (size_t size, enum malloc_tag tag) {
+	return do_malloc (size, tag, __builtin_return_address (0));
+}
+
+/* Allocates SIZE bytes charged to TAG on behalf of CALLER. */
+static void *
+do_malloc (size_t size, enum malloc_tag tag, void *caller UNUSED) {
 	struct desc *d;
 	struct block *b;
 	struct arena *a;
 
+	ASSERT (tag < MT_CNT);
+
 	/* A null pointer satisfies a request for 0 bytes. */
 	if (size == 0)
 		return NULL;
 
+#ifdef MALLOC_DEBUG
+	size_t req = size;
+	size += sizeof (struct alloc_hdr);
+#endif
+
 	/* Find the smallest descriptor that satisfies a SIZE-byte
 	   request. */
-	for (d = descs; d < descs + desc_cnt; d++)
-		if (d->block_size >= size)
-			break;
-	if (d == descs + desc_cnt) {
+	d = size_to_desc (tag, size);
+	if (d == NULL) {
 		/* SIZE is too big for any descriptor.
 		   Allocate enough pages to hold SIZE plus an arena. */
 		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
@@ -107,9 +229,13 @@ malloc (size_t size) {
 		/* Initialize the arena to indicate a big block of PAGE_CNT
 		   pages, and return it. */
 		a->magic = ARENA_MAGIC;
+		a->tag = tag;
 		a->desc = NULL;
 		a->free_cnt = page_cnt;
-		return a + 1;
+		charge (tag, page_cnt * PGSIZE);
+		tag_stats[tag].big_pages += page_cnt;
+		b = (struct block *) (a + 1);
+		goto done;
 	}
 
 	lock_acquire (&d->lock);
@@ -118,29 +244,65 @@ malloc (size_t size) {
 	if (list_empty (&d->free_list)) {
 		size_t i;
 
-		/* Allocate a page. */
-		a = palloc_get_page (0);
+		/* Allocate an arena, aligned to its size. */
+		a = palloc_get_multiple_aligned (0, d->arena_pages, d->arena_pages);
 		if (a == NULL) {
 			lock_release (&d->lock);
 			return NULL;
 		}
 
 		/* Initialize arena and add its blocks to the free list. */
+		if (d->arena_pages > 1)
+			palloc_set_tag (a, d->arena_pages, d->arena_pages);
 		a->magic = ARENA_MAGIC;
+		a->tag = tag;
 		a->desc = d;
 		a->free_cnt = d->blocks_per_arena;
 		for (i = 0; i < d->blocks_per_arena; i++) {
 			struct block *b = arena_to_block (a, i);
 			list_push_back (&d->free_list, &b->free_elem);
 		}
+		d->arena_cnt++;
 	}
 
 	/* Get a block from free list and return it. */
 	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
 	a = block_to_arena (b);
 	a->free_cnt--;
+	d->used_cnt++;
 	lock_release (&d->lock);
+	charge (tag, d->block_size);
+
+done:
+#ifdef MALLOC_DEBUG
+	{
+		struct alloc_hdr *h = (struct alloc_hdr *) b;
+		enum intr_level old_level;
+
+		h->caller = caller;
+		h->size = req;
+		h->tid = thread_current ()->tid;
+		h->tag = tag;
+		old_level = intr_disable ();
+		list_push_back (&live_list, &h->elem);
+		intr_set_level (old_level);
+		return h + 1;
+	}
+#else
 	return b;
+#endif
+}
+
+/* Returns TAG's smallest descriptor whose blocks hold SIZE
+   bytes, or a null pointer if SIZE needs a big block. */
+static struct desc *
+size_to_desc (enum malloc_tag tag, size_t size) {
+	struct desc *d;
+
+	for (d = descs[tag]; d < descs[tag] + desc_cnt; d++)
+		if (d->block_size >= size)
+			return d;
+	return NULL;
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -163,14 +325,26 @@ calloc (size_t a, size_t b) {
 	return p;
 }
 
+/* Returns the block that P, as returned by malloc(), lives in. */
+static struct block *
+ptr_to_block (void *p) {
+#ifdef MALLOC_DEBUG
+	return (struct block *) ((struct alloc_hdr *) p - 1);
+#else
+	return p;
+#endif
+}
+
 /* Returns the number of bytes allocated for BLOCK. */
 static size_t
 block_size (void *block) {
-	struct block *b = block;
+	struct block *b = ptr_to_block (block);
 	struct arena *a = block_to_arena (b);
 	struct desc *d = a->desc;
+	size_t size = d != NULL ? d->block_size
+	                        : PGSIZE * a->free_cnt - pg_ofs (b);
 
-	return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
+	return size - ((uint8_t *) block - (uint8_t *) b);
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
@@ -178,14 +352,23 @@ block_size (void *block) {
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
-   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK).
+   The new block is charged to the same tag as OLD_BLOCK. */
 void *
 realloc (void *old_block, size_t new_size) {
 	if (new_size == 0) {
 		free (old_block);
 		return NULL;
 	} else {
-		void *new_block = malloc (new_size);
+		enum malloc_tag tag = MT_MISC;
+		void *new_block;
+
+		if (old_block != NULL) {
+			if (resize_in_place (old_block, new_size))
+				return old_block;
+			tag = block_to_arena (ptr_to_block (old_block))->tag;
+		}
+		new_block = do_malloc (new_size, tag, __builtin_return_address (0));
 		if (old_block != NULL && new_block != NULL) {
 			size_t old_size = block_size (old_block);
 			size_t min_size = new_size < old_size ? new_size : old_size;
@@ -196,15 +379,65 @@ realloc (void *old_block, size_t new_size) {
 	}
 }
 
+/* Tries to resize BLOCK to NEW_SIZE bytes without moving it.
+   A block in an arena stays put as long as malloc() would pick
+   the same size class for NEW_SIZE.  A big block gives back the
+   pages it no longer needs, or claims the pages right after it
+   from the page allocator.  Returns true if successful. */
+static bool
+resize_in_place (void *block, size_t new_size) {
+	struct block *b = ptr_to_block (block);
+	struct arena *a = block_to_arena (b);
+	size_t size = new_size + ((uint8_t *) block - (uint8_t *) b);
+	size_t page_cnt;
+
+	if (a->desc != NULL) {
+		if (size_to_desc (a->tag, size) != a->desc)
+			return false;
+	} else {
+		/* A big block shrunk enough to fit a size class moves
+		   there. */
+		if (size_to_desc (a->tag, size) != NULL)
+			return false;
+
+		page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
+		if (page_cnt < a->free_cnt)
+			palloc_free_multiple ((uint8_t *) a + page_cnt * PGSIZE,
+					a->free_cnt - page_cnt);
+		else if (page_cnt > a->free_cnt
+				&& !palloc_grow_multiple (a, a->free_cnt, page_cnt))
+			return false;
+
+		if (page_cnt != a->free_cnt) {
+			recharge (a->tag, a->free_cnt * PGSIZE, page_cnt * PGSIZE);
+			a->free_cnt = page_cnt;
+		}
+	}
+
+#ifdef MALLOC_DEBUG
+	/* Record the new requested size, as do_malloc() does. */
+	((struct alloc_hdr *) b)->size = new_size;
+#endif
+	return true;
+}
+
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) {
 	if (p != NULL) {
-		struct block *b = p;
+		struct block *b = ptr_to_block (p);
 		struct arena *a = block_to_arena (b);
 		struct desc *d = a->desc;
 
+#ifdef MALLOC_DEBUG
+		{
+			enum intr_level old_level = intr_disable ();
+			list_remove (&((struct alloc_hdr *) b)->elem);
+			intr_set_level (old_level);
+		}
+#endif
+
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
 
@@ -213,10 +446,12 @@ free (void *p) {
 			memset (b, 0xcc, d->block_size);
 #endif
 
+			uncharge (d->tag, d->block_size);
 			lock_acquire (&d->lock);
 
 			/* Add block to free list. */
 			list_push_front (&d->free_list, &b->free_elem);
+			d->used_cnt--;
 
 			/* If the arena is now entirely unused, free it. */
 			if (++a->free_cnt >= d->blocks_per_arena) {
@@ -227,22 +462,143 @@ free (void *p) {
 					struct block *b = arena_to_block (a, i);
 					list_remove (&b->free_elem);
 				}
-				palloc_free_page (a);
+				palloc_free_multiple (a, d->arena_pages);
+				d->arena_cnt--;
 			}
 
 			lock_release (&d->lock);
 		} else {
 			/* It's a big block.  Free its pages. */
+			enum intr_level old_level = intr_disable ();
+			tag_stats[a->tag].big_pages -= a->free_cnt;
+			intr_set_level (old_level);
+			uncharge (a->tag, a->free_cnt * PGSIZE);
 			palloc_free_multiple (a, a->free_cnt);
 			return;
 		}
 	}
 }
+
+/* Charges BYTES to TAG. */
+static void
+charge (enum malloc_tag tag, size_t bytes) {
+	struct tag_stats *ts = &tag_stats[tag];
+	enum intr_level old_level = intr_disable ();
+
+	ts->live_bytes += bytes;
+	if (ts->live_bytes > ts->peak_bytes)
+		ts->peak_bytes = ts->live_bytes;
+	ts->alloc_cnt++;
+	intr_set_level (old_level);
+}
+
+/* Returns BYTES charged to TAG. */
+static void
+uncharge (enum malloc_tag tag, size_t bytes) {
+	struct tag_stats *ts = &tag_stats[tag];
+	enum intr_level old_level = intr_disable ();
+
+	ASSERT (ts->live_bytes >= bytes);
+	ts->live_bytes -= bytes;
+	ts->free_cnt++;
+	intr_set_level (old_level);
+}
+
+/* Moves TAG's charge for a big block from OLD_BYTES to
+   NEW_BYTES. */
+static void
+recharge (enum malloc_tag tag, size_t old_bytes, size_t new_bytes) {
+	struct tag_stats *ts = &tag_stats[tag];
+	enum intr_level old_level = intr_disable ();
+
+	ts->live_bytes = ts->live_bytes - old_bytes + new_bytes;
+	if (ts->live_bytes > ts->peak_bytes)
+		ts->peak_bytes = ts->live_bytes;
+	ts->big_pages = ts->big_pages - old_bytes / PGSIZE + new_bytes / PGSIZE;
+	intr_set_level (old_level);
+}
+
+/* Prints per-tag usage and per-size-class arena usage. */
+void
+malloc_print_stats (void) {
+	int64_t secs = timer_ticks () / TIMER_FREQ;
+	size_t i;
+	int tag;
+
+	printf ("malloc: %-8s %10s %10s %10s %10s %8s\n",
+			"tag", "live", "peak", "allocs", "frees", "allocs/s");
+	for (tag = 0; tag < MT_CNT; tag++) {
+		struct tag_stats *ts = &tag_stats[tag];
+		if (ts->alloc_cnt == 0)
+			continue;
+		printf ("malloc: %-8s %10zu %10zu %10llu %10llu %8llu\n",
+				tag_names[tag], ts->live_bytes, ts->peak_bytes,
+				ts->alloc_cnt, ts->free_cnt,
+				ts->alloc_cnt / (secs > 0 ? secs : 1));
+	}
+
+	/* Fragmentation: free blocks sitting in partially used arenas. */
+	for (i = 0; i < desc_cnt; i++) {
+		size_t arenas = 0, used = 0, big = 0;
+		for (tag = 0; tag < MT_CNT; tag++) {
+			arenas += descs[tag][i].arena_cnt;
+			used += descs[tag][i].used_cnt;
+		}
+		if (arenas == 0)
+			continue;
+		big = arenas * descs[0][i].blocks_per_arena;
+		printf ("malloc: class %4zu: %zu arenas, %zu/%zu blocks used (%zu%% free)\n",
+				descs[0][i].block_size, arenas, used, big,
+				(big - used) * 100 / big);
+	}
+	for (tag = 0; tag < MT_CNT; tag++)
+		if (tag_stats[tag].big_pages != 0)
+			printf ("malloc: %s: %zu pages in big blocks\n",
+					tag_names[tag], tag_stats[tag].big_pages);
+}
+
+/* Reports allocations still live that were made by thread TID,
+   or every live allocation if TID is TID_ERROR.  WHO names the
+   point at which the check is made.  Does nothing unless the
+   kernel was built with MALLOC_DEBUG. */
+void
+malloc_check_leaks (const char *who UNUSED, int tid UNUSED) {
+#ifdef MALLOC_DEBUG
+	enum intr_level old_level = intr_disable ();
+	struct list_elem *e;
+	size_t cnt = 0, bytes = 0;
+
+	for (e = list_begin (&live_list); e != list_end (&live_list);
+			e = list_next (e)) {
+		struct alloc_hdr *h = list_entry (e, struct alloc_hdr, elem);
+		if (tid != TID_ERROR && h->tid != tid)
+			continue;
+		if (cnt++ < 16)
+			printf ("leak: %s: %zu bytes (%s) from %p by tid %d\n",
+					who, h->size, tag_names[h->tag], h->caller, h->tid);
+		bytes += h->size;
+	}
+	if (cnt != 0)
+		printf ("leak: %s: %zu allocations, %zu bytes live\n", who, cnt, bytes);
+	intr_set_level (old_level);
+#endif
+}
 
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
-	struct arena *a = pg_round_down (b);
+	struct arena *a;
+	size_t pages;
+
+	/* The pages of a multi-page arena are tagged with its size,
+	   and it is aligned to that size, so it starts at B rounded
+	   down to it.  Other arenas are single pages. */
+	pages = palloc_get_tag (b);
+	ASSERT (pages <= MAX_ARENA_PAGES);
+	if (pages > 1)
+		a = (struct arena *) ((uintptr_t) b & ~(uintptr_t) (pages * PGSIZE - 1));
+	else
+		a = pg_round_down (b);
 
 	/* Check that the arena is valid. */
 	ASSERT (a != NULL);
@@ -250,7 +606,8 @@ block_to_arena (struct block *b) {
 
 	/* Check that the block is properly aligned for the arena. */
 	ASSERT (a->desc == NULL
-			|| (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+			|| ((uint8_t *) b - (uint8_t *) a - sizeof *a)
+			% a->desc->block_size == 0);
 	ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
 	return a;
@@ -2,6 +2,7 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
@@ -15,6 +16,9 @@ pgdir_walk(uint64_t *pdp, const uint64_t va, int create)
 	if (pdp)
 	{
 		uint64_t *pte = (uint64_t *)pdp[idx];
+		/* A 2 MB mapping has no page table; the PDE is the leaf. */
+		if (((uint64_t)pte & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS))
+			return &pdp[idx];
 		if (!((uint64_t)pte & PTE_P))
 		{
 			if (create)
@@ -68,12 +72,149 @@ pdpe_walk(uint64_t *pdpe, const uint64_t va, int create)
 	return pte;
 }
 
+/* Process-context identifiers.
+ *
+ * With CR4.PCIDE set, the low 12 bits of CR3 tag every TLB entry
+ * with the PCID of the address space that created it, so a CR3
+ * load with CR3_NOFLUSH does not throw away other processes'
+ * translations.  PCID 0 belongs to base_pml4; user page tables
+ * get one of the remaining PCID_CNT - 1 ids on first activation,
+ * recycled round-robin when the pool runs out.  A recycled id may
+ * still have the old owner's entries in the TLB, so it is marked
+ * stale and flushed before its new owner runs. */
+#define PCID_CNT 64                  /* Size of the recycling pool. */
+#define CR3_NOFLUSH (1UL << 63)      /* Keep the new PCID's entries. */
+#define CR4_PCIDE (1UL << 17)        /* CR4: enable PCIDs. */
+#define CPUID_1_ECX_PCID (1U << 17)  /* CPUID.01H:ECX: PCID support. */
+#define CPUID_7_EBX_INVPCID (1U << 10) /* CPUID.07H:EBX: INVPCID. */
+#define INVPCID_ADDR 0               /* INVPCID: one address. */
+#define INVPCID_CONTEXT 1            /* INVPCID: a whole PCID. */
+
+static bool pcid_enabled;	 /* CR4.PCIDE is set. */
+static bool invpcid_enabled; /* INVPCID is available. */
+
+/* Owner of each PCID.  Accessed with interrupts off. */
+static struct pcid_slot
+{
+	uint64_t *pml4; /* Page table using this PCID, or NULL. */
+	bool stale;		/* May hold TLB entries that must go. */
+} pcid_slots[PCID_CNT];
+static unsigned pcid_hand = 1; /* Next PCID to recycle. */
+
+/* Turns on PCIDs if the CPU supports them.  Must be called after
+ * base_pml4 is active with PCID 0. */
+void pml4_pcid_init(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+	if (!(ecx & CPUID_1_ECX_PCID))
+		return;
+	lcr4(rcr4() | CR4_PCIDE);
+	pcid_enabled = true;
+
+	cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+	if (eax >= 7)
+	{
+		cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+		invpcid_enabled = (ebx & CPUID_7_EBX_INVPCID) != 0;
+	}
+}
+
+/* Returns the PCID owned by PML4, or 0 if it has none. */
+static int
+pcid_lookup(uint64_t *pml4)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+	for (int i = 1; i < PCID_CNT; i++)
+		if (pcid_slots[i].pml4 == pml4)
+			return i;
+	return 0;
+}
+
+/* Gives PML4 a PCID, preferring an unused one and otherwise taking
+ * the next one round-robin from its current owner. */
+static int
+pcid_assign(uint64_t *pml4)
+{
+	int pcid = 0;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+	for (int i = 1; i < PCID_CNT && pcid == 0; i++)
+		if (pcid_slots[i].pml4 == NULL)
+			pcid = i;
+	if (pcid == 0)
+	{
+		pcid = pcid_hand;
+		pcid_hand = pcid_hand + 1 < PCID_CNT ? pcid_hand + 1 : 1;
+	}
+	pcid_slots[pcid].pml4 = pml4;
+	pcid_slots[pcid].stale = true;
+	return pcid;
+}
+
+/* Gives up PML4's PCID, if any.  Its TLB entries stay until the
+ * PCID is assigned again. */
+static void
+pcid_release(uint64_t *pml4)
+{
+	enum intr_level old_level;
+	int pcid;
+
+	if (!pcid_enabled)
+		return;
+	old_level = intr_disable();
+	pcid = pcid_lookup(pml4);
+	if (pcid != 0)
+		pcid_slots[pcid].pml4 = NULL;
+	intr_set_level(old_level);
+}
+
+/* Returns true if PML4 is the page table the CPU is using. */
+static bool
+pml4_is_active(uint64_t *pml4)
+{
+	return PTE_ADDR(rcr3()) == vtop(pml4);
+}
+
+/* Removes any TLB entry for VA in the address space of PML4.
+ * An inactive PML4 only needs this if it holds a PCID, since
+ * otherwise its next activation flushes everything anyway. */
+static void
+tlb_invalidate(uint64_t *pml4, uint64_t va)
+{
+	enum intr_level old_level;
+	int pcid;
+
+	if (pml4_is_active(pml4))
+	{
+		invlpg(va);
+		return;
+	}
+	if (!pcid_enabled)
+		return;
+
+	old_level = intr_disable();
+	pcid = pcid_lookup(pml4);
+	if (pcid != 0)
+	{
+		if (invpcid_enabled)
+			invpcid(INVPCID_ADDR, pcid, va);
+		else
+			pcid_slots[pcid].stale = true;
+	}
+	intr_set_level(old_level);
+}
+
 /* Returns the address of the page table entry for virtual
  * address VADDR in page map level 4, pml4.
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.
+ * If VADDR lies in a 2 MB mapping, the returned entry is the page
+ * directory entry with PTE_PS set.  Callers that modify the entry
+ * should check is_huge_pte(). */
 uint64_t *
 pml4e_walk(uint64_t *pml4e, const uint64_t va, int create)
 {
@@ -109,6 +250,38 @@ pml4e_walk(uint64_t *pml4e, const uint64_t va, int create)
 	return pte;
 }
 
+/* Makes *ENTRY point to a new, zeroed paging structure.  Returns
+ * false if out of memory. */
+static bool
+alloc_table(uint64_t *entry)
+{
+	uint64_t *new_page = palloc_get_page(PAL_ZERO);
+	if (new_page == NULL)
+		return false;
+	*entry = vtop(new_page) | PTE_U | PTE_W | PTE_P;
+	return true;
+}
+
+/* Returns the address of the page directory entry covering
+ * virtual address VA in PML4, without descending into a page
+ * table.  Missing upper levels are allocated if CREATE is true;
+ * otherwise a null pointer is returned for them. */
+uint64_t *
+pml4e_walk_pde(uint64_t *pml4, const uint64_t va, int create)
+{
+	uint64_t *pdpe, *pde;
+
+	if (!(pml4[PML4(va)] & PTE_P))
+		if (!create || !alloc_table(&pml4[PML4(va)]))
+			return NULL;
+	pdpe = ptov(PTE_ADDR(pml4[PML4(va)]));
+	if (!(pdpe[PDPE(va)] & PTE_P))
+		if (!create || !alloc_table(&pdpe[PDPE(va)]))
+			return NULL;
+	pde = ptov(PTE_ADDR(pdpe[PDPE(va)]));
+	return &pde[PDX(va)];
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -149,7 +322,16 @@ pgdir_for_each(uint64_t *pdp, pte_for_each_func *func, void *aux,
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
 	{
 		uint64_t *pte = ptov((uint64_t *)pdp[i]);
-		if (((uint64_t)pte) & PTE_P)
+		if ((pdp[i] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS))
+		{
+			/* 2 MB mapping: hand the PDE itself to FUNC. */
+			void *va = (void *)(((uint64_t)pml4_index << PML4SHIFT) |
+								((uint64_t)pdp_index << PDPESHIFT) |
+								((uint64_t)i << PDXSHIFT));
+			if (!func(&pdp[i], va, aux))
+				return false;
+		}
+		else if (((uint64_t)pte) & PTE_P)
 			if (!pt_for_each((uint64_t *)PTE_ADDR(pte), func, aux,
 							 pml4_index, pdp_index, i))
 				return false;
@@ -172,7 +354,9 @@ pdp_for_each(uint64_t *pdp,
 	return true;
 }
 
-/* Apply FUNC to each available pte entries including kernel's. */
+/* Apply FUNC to each available pte entries including kernel's.
+ * A 2 MB mapping is visited once, with its PDE (is_huge_pte()
+ * is true) and the address of its first byte. */
 // PML4에 있는 각 유효한 항목에 대해 주어진 func 수행
 // false를 반환하면 반복을 중지하고 false 반환
 bool pml4_for_each(uint64_t *pml4, pte_for_each_func *func, void *aux)
@@ -205,7 +389,10 @@ pgdir_destroy(uint64_t *pdp)
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
 	{
 		uint64_t *pte = ptov((uint64_t *)pdp[i]);
-		if (((uint64_t)pte) & PTE_P)
+		if ((pdp[i] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS))
+			palloc_free_multiple(ptov(PTE_ADDR(pdp[i]) & ~HPGMASK),
+								 PGS_PER_HPG);
+		else if (((uint64_t)pte) & PTE_P)
 			pt_destroy(PTE_ADDR(pte));
 	}
 	palloc_free_page((void *)pdp);
@@ -230,6 +417,8 @@ void pml4_destroy(uint64_t *pml4)
 		return;
 	ASSERT(pml4 != base_pml4);
 
+	pcid_release(pml4);
+
 	/* if PML4 (vaddr) >= 1, it's kernel space by define. */
 	uint64_t *pdpe = ptov((uint64_t *)pml4[0]);
 	if (((uint64_t)pdpe) & PTE_P)
@@ -238,10 +427,39 @@ void pml4_destroy(uint64_t *pml4)
 }
 
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.
+ * With PCIDs enabled, the TLB entries of the address space being
+ * switched away from are kept, and those of PML4 are reused
+ * unless its PCID was just (re)assigned or marked stale. */
 void pml4_activate(uint64_t *pml4)
 {
-	lcr3(vtop(pml4 ? pml4 : base_pml4));
+	enum intr_level old_level;
+	uint64_t cr3;
+	int pcid;
+
+	if (pml4 == NULL || !pcid_enabled)
+	{
+		/* The kernel-only mappings never change after boot. */
+		lcr3(vtop(pml4 ? pml4 : base_pml4) | (pcid_enabled ? CR3_NOFLUSH : 0));
+		return;
+	}
+
+	old_level = intr_disable();
+	pcid = pcid_lookup(pml4);
+	if (pcid == 0)
+		pcid = pcid_assign(pml4);
+
+	cr3 = vtop(pml4) | pcid;
+	if (!pcid_slots[pcid].stale)
+		cr3 |= CR3_NOFLUSH;
+	else if (invpcid_enabled)
+	{
+		invpcid(INVPCID_CONTEXT, pcid, 0);
+		cr3 |= CR3_NOFLUSH;
+	}
+	pcid_slots[pcid].stale = false;
+	lcr3(cr3);
+	intr_set_level(old_level);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -256,7 +474,12 @@ pml4_get_page(uint64_t *pml4, const void *uaddr)
 	uint64_t *pte = pml4e_walk(pml4, (uint64_t)uaddr, 0);
 
 	if (pte && (*pte & PTE_P))
+	{
+		if (is_huge_pte(pte))
+			return ptov(PTE_ADDR(*pte) & ~HPGMASK) +
+				   ((uint64_t)uaddr & HPGMASK);
 		return ptov(PTE_ADDR(*pte)) + pg_ofs(uaddr);
+	}
 	return NULL;
 }
 
@@ -277,35 +500,262 @@ bool pml4_set_page(uint64_t *pml4, void *upage, void *kpage, bool rw)
 
 	uint64_t *pte = pml4e_walk(pml4, (uint64_t)upage, 1);
 
+	/* Remapping one page of a 2 MB mapping needs its own PTE. */
+	if (pte && is_huge_pte(pte))
+		pte = pml4_split_huge_page(pml4, upage)
+				  ? pml4e_walk(pml4, (uint64_t)upage, 1)
+				  : NULL;
 	if (pte)
 		*pte = vtop(kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
 	return pte != NULL;
 }
 
-/* Marks user virtual page UPAGE "not present" in page
- * directory PD.  Later accesses to the page will fault.  Other
- * bits in the page table entry are preserved.
- * UPAGE need not be mapped. */
-void pml4_clear_page(uint64_t *pml4, void *upage)
+/* Adds a 2 MB mapping in PML4 from user virtual address UPAGE to
+ * the physically contiguous frames starting at kernel virtual
+ * address KPAGE.  Both must be aligned to HPGSIZE.  A page table
+ * already covering UPAGE is freed if none of its pages is mapped;
+ * otherwise the call fails.  Returns true if successful, false if
+ * memory allocation failed or 4 kB mappings are in the way. */
+bool pml4_set_huge_page(uint64_t *pml4, void *upage, void *kpage, bool rw)
+{
+	ASSERT(((uint64_t)upage & HPGMASK) == 0);
+	ASSERT((vtop(kpage) & HPGMASK) == 0);
+	ASSERT(is_user_vaddr(upage));
+	ASSERT(pml4 != base_pml4);
+
+	uint64_t *pde = pml4e_walk_pde(pml4, (uint64_t)upage, 1);
+	if (pde == NULL)
+		return false;
+
+	if ((*pde & PTE_P) && !(*pde & PTE_PS))
+	{
+		uint64_t *pt = ptov(PTE_ADDR(*pde));
+		for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+			if (pt[i] & PTE_P)
+				return false;
+		palloc_free_page(pt);
+	}
+	*pde = vtop(kpage) | PTE_P | PTE_PS | (rw ? PTE_W : 0) | PTE_U;
+	tlb_invalidate(pml4, (uint64_t)upage);
+	return true;
+}
+
+/* Maps SIZE bytes of user virtual memory starting at UPAGE to the
+ * physically contiguous frames starting at KPAGE.  Every 2 MB
+ * stretch where both addresses are suitably aligned gets a single
+ * huge mapping; the rest is mapped with 4 kB pages.  Returns
+ * false on failure, in which case part of the range may have been
+ * mapped. */
+bool pml4_set_range(uint64_t *pml4, void *upage, void *kpage, size_t size,
+					bool rw)
+{
+	ASSERT(pg_ofs(size) == 0);
+
+	while (size > 0)
+	{
+		size_t step = PGSIZE;
+		bool ok;
+
+		if (((uint64_t)upage & HPGMASK) == 0 && (vtop(kpage) & HPGMASK) == 0 && size >= HPGSIZE)
+		{
+			step = HPGSIZE;
+			ok = pml4_set_huge_page(pml4, upage, kpage, rw);
+		}
+		else
+			ok = pml4_set_page(pml4, upage, kpage, rw);
+		if (!ok)
+			return false;
+		upage += step;
+		kpage += step;
+		size -= step;
+	}
+	return true;
+}
+
+/* Replaces the 2 MB mapping covering UPAGE in PML4, if any, with
+ * 512 4 kB mappings of the same frames, keeping the permission,
+ * accessed and dirty bits.  Returns true if UPAGE is now covered
+ * by 4 kB entries (or by nothing), false if no page table could
+ * be allocated. */
+bool pml4_split_huge_page(uint64_t *pml4, void *upage)
+{
+	uint64_t *pde = pml4e_walk_pde(pml4, (uint64_t)upage, 0);
+	uint64_t *pt, pa, flags;
+
+	if (pde == NULL || !(*pde & PTE_PS))
+		return true;
+
+	pt = palloc_get_page(0);
+	if (pt == NULL)
+		return false;
+
+	pa = PTE_ADDR(*pde) & ~HPGMASK;
+	flags = *pde & PTE_FLAGS & ~PTE_PS;
+	for (unsigned i = 0; i < PGS_PER_HPG; i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop(pt) | PTE_U | PTE_W | PTE_P;
+
+	/* One invalidation drops the whole 2 MB TLB entry. */
+	tlb_invalidate(pml4, (uint64_t)hpg_round_down(upage));
+	return true;
+}
+
+/* Clears the present bit of the entry mapping UPAGE in PML4 and
+ * returns the entry, or returns a null pointer if UPAGE was not
+ * mapped.  The TLB is left alone. */
+static uint64_t *
+clear_pte(uint64_t *pml4, void *upage)
 {
 	uint64_t *pte;
 	ASSERT(pg_ofs(upage) == 0);
 	ASSERT(is_user_vaddr(upage));
 
 	pte = pml4e_walk(pml4, (uint64_t)upage, false);
+	if (pte != NULL && is_huge_pte(pte) && pml4_split_huge_page(pml4, upage))
+		pte = pml4e_walk(pml4, (uint64_t)upage, false);
+
+	if (pte == NULL || (*pte & PTE_P) == 0)
+		return NULL;
+	*pte &= ~PTE_P;
+	return pte;
+}
+
+/* Marks user virtual page UPAGE "not present" in page
+ * directory PD.  Later accesses to the page will fault.  Other
+ * bits in the page table entry are preserved.
+ * UPAGE need not be mapped.
+ * A 2 MB mapping covering UPAGE is first split so that only UPAGE
+ * goes away; if that is impossible for lack of memory, the whole
+ * 2 MB mapping is marked not present. */
+void pml4_clear_page(uint64_t *pml4, void *upage)
+{
+	if (clear_pte(pml4, upage) != NULL)
+		tlb_invalidate(pml4, (uint64_t)upage);
+}
+
+/* Drops every TLB entry of the address space of PML4. */
+static void
+tlb_flush_all(uint64_t *pml4)
+{
+	enum intr_level old_level;
+	int pcid;
+
+	if (pml4_is_active(pml4))
+	{
+		/* CR3 reads back without CR3_NOFLUSH, so this flushes. */
+		lcr3(rcr3());
+		return;
+	}
+	if (!pcid_enabled)
+		return;
+
+	old_level = intr_disable();
+	pcid = pcid_lookup(pml4);
+	if (pcid != 0)
+	{
+		if (invpcid_enabled)
+			invpcid(INVPCID_CONTEXT, pcid, 0);
+		else
+			pcid_slots[pcid].stale = true;
+	}
+	intr_set_level(old_level);
+}
+
+/* Starts gathering unmaps of pages in PML4 into TLB.
+ * If FULLMM is true, the caller is tearing down the whole address
+ * space and will switch away from PML4 before returning to user
+ * mode, so no invalidation is needed at all and page tables are
+ * left for pml4_destroy() to free. */
+void tlb_gather_init(struct tlb_gather *tlb, uint64_t *pml4, bool fullmm)
+{
+	tlb->pml4 = pml4;
+	tlb->fullmm = fullmm;
+	tlb->flush_all = false;
+	tlb->va_cnt = 0;
+	tlb->table_cnt = 0;
+}
+
+/* Like pml4_clear_page(), but defers the TLB invalidation for
+ * UPAGE to tlb_gather_finish(). */
+void pml4_clear_page_gather(struct tlb_gather *tlb, void *upage)
+{
+	uint64_t *pte = clear_pte(tlb->pml4, upage);
+
+	if (pte == NULL || tlb->fullmm)
+		return;
+
+	if (tlb->va_cnt < TLB_GATHER_MAX)
+		tlb->vas[tlb->va_cnt++] = (uint64_t)upage;
+	else
+		tlb->flush_all = true;
+
+	/* Remember the page table, so it can be freed once empty.
+	 * Unmaps are usually sequential, so checking the last one
+	 * catches nearly all duplicates. */
+	if (tlb->table_cnt == 0 || (tlb->tables[tlb->table_cnt - 1] >> PDXSHIFT) != ((uint64_t)upage >> PDXSHIFT))
+		if (tlb->table_cnt < TLB_GATHER_TABLES)
+			tlb->tables[tlb->table_cnt++] = (uint64_t)upage;
+}
+
+/* Returns true if no entry of page table PT is present. */
+static bool
+pt_is_empty(const uint64_t *pt)
+{
+	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+		if (pt[i] & PTE_P)
+			return false;
+	return true;
+}
 
-	if (pte != NULL && (*pte & PTE_P) != 0)
+/* Issues the invalidations gathered in TLB, either one by one or,
+ * past TLB_GATHER_MAX pages, as a single flush of the address
+ * space.  Page tables left empty by the unmaps are unhooked
+ * before the flush and freed after it, so the MMU can no longer
+ * be walking them when they are reused.  TLB may be reused
+ * afterwards. */
+void tlb_gather_finish(struct tlb_gather *tlb)
+{
+	uint64_t *pml4 = tlb->pml4;
+	void *freed[TLB_GATHER_TABLES];
+	size_t freed_cnt = 0;
+
+	for (size_t i = 0; i < tlb->table_cnt; i++)
 	{
-		*pte &= ~PTE_P;
-		if (rcr3() == vtop(pml4))
-			invlpg((uint64_t)upage);
+		uint64_t *pde = pml4e_walk_pde(pml4, tlb->tables[i], false);
+		uint64_t *pt;
+
+		if (pde == NULL || !(*pde & PTE_P) || (*pde & PTE_PS))
+			continue;
+		pt = ptov(PTE_ADDR(*pde));
+		if (!pt_is_empty(pt))
+			continue;
+		/* The address recorded for the table is also among the
+		 * gathered ones (or flush_all is set), so the flush below
+		 * drops any cached copy of this PDE too. */
+		*pde = 0;
+		freed[freed_cnt++] = pt;
 	}
+
+	if (tlb->flush_all)
+		tlb_flush_all(pml4);
+	else
+		for (size_t i = 0; i < tlb->va_cnt; i++)
+			tlb_invalidate(pml4, tlb->vas[i]);
+
+	for (size_t i = 0; i < freed_cnt; i++)
+		palloc_free_page(freed[i]);
+
+	tlb->flush_all = false;
+	tlb->va_cnt = 0;
+	tlb->table_cnt = 0;
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
  * that is, if the page has been modified since the PTE was
  * installed.
- * Returns false if PML4 contains no PTE for VPAGE. */
+ * Returns false if PML4 contains no PTE for VPAGE.
+ * For a page inside a 2 MB mapping, this and the other accessed
+ * and dirty bit functions below operate on the whole mapping. */
 bool pml4_is_dirty(uint64_t *pml4, const void *vpage)
 {
 	uint64_t *pte = pml4e_walk(pml4, (uint64_t)vpage, false);
@@ -322,10 +772,9 @@ void pml4_set_dirty(uint64_t *pml4, const void *vpage, bool dirty)
 		if (dirty)
 			*pte |= PTE_D;
 		else
-			*pte &= ~(uint32_t)PTE_D;
+			*pte &= ~(uint64_t)PTE_D;
 
-		if (rcr3() == vtop(pml4))
-			invlpg((uint64_t)vpage);
+		tlb_invalidate(pml4, (uint64_t)vpage);
 	}
 }
 
@@ -349,9 +798,25 @@ void pml4_set_accessed(uint64_t *pml4, const void *vpage, bool accessed)
 		if (accessed)
 			*pte |= PTE_A;
 		else
-			*pte &= ~(uint32_t)PTE_A;
+			*pte &= ~(uint64_t)PTE_A;
+
+		tlb_invalidate(pml4, (uint64_t)vpage);
+	}
+}
+
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+   VPAGE in PML4, keeping the accessed and dirty bits, e.g. to
+   write-protect a page shared copy-on-write. */
+void pml4_set_writable(uint64_t *pml4, const void *vpage, bool writable)
+{
+	uint64_t *pte = pml4e_walk(pml4, (uint64_t)vpage, false);
+	if (pte)
+	{
+		if (writable)
+			*pte |= PTE_W;
+		else
+			*pte &= ~(uint64_t)PTE_W;
 
-		if (rcr3() == vtop(pml4))
-			invlpg((uint64_t)vpage);
+		tlb_invalidate(pml4, (uint64_t)vpage);
 	}
 }
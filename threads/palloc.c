@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -30,7 +31,18 @@
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
+	uint8_t *tags;                  /* Owner's tag of each page, 0 if
+	                                   none; see palloc_set_tag(). */
 	uint8_t *base;                  /* Base of pool. */
+
+	/* Statistics.  palloc_free_page() may run with interrupts
+	   off inside the scheduler, where LOCK cannot be taken, so
+	   these are updated with interrupts disabled instead. */
+	size_t used_cnt;                /* Pages currently in use. */
+	size_t peak_cnt;                /* High-water mark of USED_CNT. */
+	unsigned long long alloc_cnt;   /* Successful allocations. */
+	unsigned long long fail_cnt;    /* Failed allocations. */
+	unsigned long long free_cnt;    /* Calls to free. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +54,11 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static struct pool *pool_of (const void *page);
+static size_t scan_aligned (struct pool *, size_t page_cnt, size_t align);
+static void account (struct pool *, long page_delta);
+static void reset_pool_stats (struct pool *);
+static void print_pool_stats (const char *name, struct pool *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -250,6 +267,8 @@ palloc_init (void) {
 	printf ("\text_mem: 0x%llx ~ 0x%llx (Usable: %'llu kB)\n",
 		  ext_mem.start, ext_mem.end, ext_mem.size / 1024);
 	populate_pools (&base_mem, &ext_mem);
+	reset_pool_stats (&kernel_pool);
+	reset_pool_stats (&user_pool);
 	return ext_mem.end;
 }
 
@@ -261,11 +280,23 @@ palloc_init (void) {
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
+	return palloc_get_multiple_aligned (flags, page_cnt, 1);
+}
+
+/* Like palloc_get_multiple(), but the returned pages start at a
+   kernel virtual address that is a multiple of ALIGN pages.
+   ALIGN must be a power of 2. */
+void *
+palloc_get_multiple_aligned (enum palloc_flags flags, size_t page_cnt,
+		size_t align) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
 
+	ASSERT (align != 0 && (align & (align - 1)) == 0);
+
 	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	size_t page_idx = scan_aligned (pool, page_cnt, align);
 	lock_release (&pool->lock);
+	account (pool, page_idx != BITMAP_ERROR ? (long) page_cnt : 0);
 	void *pages;
 
 	if (page_idx != BITMAP_ERROR)
@@ -296,6 +327,43 @@ palloc_get_page (enum palloc_flags flags) {
 	return palloc_get_multiple (flags, 1);
 }
 
+/* Tries to extend the OLD_CNT pages starting at PAGES, which
+   must have been obtained from palloc_get_multiple(), to NEW_CNT
+   pages by claiming the pages that directly follow them.
+   Returns true if successful, false if any of those pages is in
+   use or lies outside the pool. */
+bool
+palloc_grow_multiple (void *pages, size_t old_cnt, size_t new_cnt) {
+	struct pool *pool;
+	size_t page_idx;
+	bool success = false;
+
+	ASSERT (pg_ofs (pages) == 0);
+	ASSERT (new_cnt >= old_cnt);
+	if (new_cnt == old_cnt)
+		return true;
+
+	if (page_from_pool (&kernel_pool, pages))
+		pool = &kernel_pool;
+	else if (page_from_pool (&user_pool, pages))
+		pool = &user_pool;
+	else
+		NOT_REACHED ();
+
+	page_idx = pg_no (pages) - pg_no (pool->base);
+	lock_acquire (&pool->lock);
+	if (page_idx + new_cnt <= bitmap_size (pool->used_map)
+			&& bitmap_none (pool->used_map, page_idx + old_cnt,
+				new_cnt - old_cnt)) {
+		bitmap_set_multiple (pool->used_map, page_idx + old_cnt,
+				new_cnt - old_cnt, true);
+		success = true;
+	}
+	lock_release (&pool->lock);
+	account (pool, success ? (long) (new_cnt - old_cnt) : 0);
+	return success;
+}
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
@@ -319,7 +387,9 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+	memset (pool->tags + page_idx, 0, page_cnt);
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	account (pool, -(long) page_cnt);
 }
 
 /* Frees the page at PAGE. */
@@ -328,17 +398,42 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Records TAG for each of the PAGE_CNT allocated pages starting
+   at PAGES, for their owner to look up with palloc_get_tag().
+   Freeing a page resets its tag to 0. */
+void
+palloc_set_tag (void *pages, size_t page_cnt, uint8_t tag) {
+	struct pool *pool = pool_of (pages);
+	size_t page_idx = pg_no (pages) - pg_no (pool->base);
+
+	ASSERT (pg_ofs (pages) == 0);
+	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+	memset (pool->tags + page_idx, tag, page_cnt);
+}
+
+/* Returns the tag of the page that holds ADDR, which must be an
+   allocated page. */
+uint8_t
+palloc_get_tag (const void *addr) {
+	struct pool *pool = pool_of (addr);
+
+	return pool->tags[pg_no (addr) - pg_no (pool->base)];
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map at its base, followed by its
+     page tags.  Calculate the space needed for them
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
-	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t bm_bytes = bitmap_buf_size (pgcnt);
+	size_t bm_pages = DIV_ROUND_UP (bm_bytes + pgcnt, PGSIZE) * PGSIZE;
 
 	lock_init(&p->lock);
-	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_bytes);
+	p->tags = (uint8_t *) *bm_base + bm_bytes;
+	memset (p->tags, 0, pgcnt);
 	p->base = (void *) start;
 
 	// Mark all to unusable.
@@ -347,6 +442,31 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
 	*bm_base += bm_pages;
 }
 
+/* Finds PAGE_CNT free pages in POOL whose first page is aligned
+   to ALIGN pages, marks them used, and returns the index of the
+   first one, or BITMAP_ERROR if there is no such run.  POOL's
+   lock must be held. */
+static size_t
+scan_aligned (struct pool *pool, size_t page_cnt, size_t align) {
+	size_t skew = (align - pg_no (pool->base) % align) % align;
+	size_t start = skew;
+
+	if (align == 1)
+		return bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+
+	while (start + page_cnt <= bitmap_size (pool->used_map)) {
+		size_t idx = bitmap_scan (pool->used_map, start, page_cnt, false);
+		if (idx == BITMAP_ERROR)
+			return BITMAP_ERROR;
+		start = skew + ROUND_UP (idx - skew, align);
+		if (start == idx) {
+			bitmap_set_multiple (pool->used_map, idx, page_cnt, true);
+			return idx;
+		}
+	}
+	return BITMAP_ERROR;
+}
+
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool
@@ -356,3 +476,87 @@ page_from_pool (const struct pool *pool, void *page) {
 	size_t end_page = start_page + bitmap_size (pool->used_map);
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the pool that PAGE was allocated from. */
+static struct pool *
+pool_of (const void *page) {
+	if (page_from_pool (&kernel_pool, (void *) page))
+		return &kernel_pool;
+	if (page_from_pool (&user_pool, (void *) page))
+		return &user_pool;
+	NOT_REACHED ();
+}
+
+/* Records an allocation (PAGE_DELTA > 0), a failed allocation
+   (PAGE_DELTA == 0) or a free (PAGE_DELTA < 0) in P's
+   statistics. */
+static void
+account (struct pool *p, long page_delta) {
+	enum intr_level old_level = intr_disable ();
+
+	if (page_delta > 0) {
+		p->used_cnt += page_delta;
+		if (p->used_cnt > p->peak_cnt)
+			p->peak_cnt = p->used_cnt;
+		p->alloc_cnt++;
+	} else if (page_delta == 0)
+		p->fail_cnt++;
+	else {
+		p->used_cnt -= -page_delta;
+		p->free_cnt++;
+	}
+	intr_set_level (old_level);
+}
+
+/* Counts the pages of P that populate_pools() left in use, so
+   that the statistics start out consistent with the bitmap. */
+static void
+reset_pool_stats (struct pool *p) {
+	p->used_cnt = bitmap_count (p->used_map, 0, bitmap_size (p->used_map), true);
+	p->peak_cnt = p->used_cnt;
+}
+
+/* Prints usage of pool P, named NAME.  The longest run of free
+   pages tells how fragmented the pool is for multi-page
+   requests.  Reads the pool without its lock, because this runs
+   from power_off(), which a kernel panic may reach with the lock
+   held; the figures may then be slightly off. */
+static void
+print_pool_stats (const char *name, struct pool *p) {
+	size_t total, longest = 0, run = 0, i;
+
+	total = bitmap_size (p->used_map);
+	for (i = 0; i < total; i++)
+		if (!bitmap_test (p->used_map, i)) {
+			if (++run > longest)
+				longest = run;
+		} else
+			run = 0;
+	printf ("palloc: %s pool: %zu/%zu pages used, peak %zu, "
+			"longest free run %zu\n", name, p->used_cnt, total,
+			p->peak_cnt, longest);
+	printf ("palloc: %s pool: %llu allocs, %llu frees, %llu failures\n",
+			name, p->alloc_cnt, p->free_cnt, p->fail_cnt);
+}
+
+/* Returns the first page of the user pool and stores the number
+   of pages it spans in *PAGE_CNT.  Every page palloc_get_page
+   (PAL_USER) can return lies in this range. */
+void *
+palloc_user_pool (size_t *page_cnt) {
+	*page_cnt = bitmap_size (user_pool.used_map);
+	return user_pool.base;
+}
+
+/* Returns the number of free pages in the user pool. */
+size_t
+palloc_user_free_cnt (void) {
+	return bitmap_size (user_pool.used_map) - user_pool.used_cnt;
+}
+
+/* Prints statistics about both page pools. */
+void
+palloc_print_stats (void) {
+	print_pool_stats ("kernel", &kernel_pool);
+	print_pool_stats ("user", &user_pool);
+}
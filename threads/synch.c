@@ -31,6 +31,7 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -100,6 +101,38 @@ bool sema_try_down(struct semaphore *sema)
 	return success;
 }
 
+/* Down or "P" operation on a semaphore, giving up after TICKS
+   timer ticks.  Returns true if the semaphore is decremented,
+   false if the time ran out first.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool sema_down_timeout(struct semaphore *sema, int64_t ticks)
+{
+	enum intr_level old_level;
+	int64_t until = timer_ticks() + ticks;
+	bool success = true;
+
+	ASSERT(sema != NULL);
+	ASSERT(!intr_context());
+
+	old_level = intr_disable();
+	while (sema->value == 0)
+	{
+		if (timer_ticks() >= until)
+		{
+			success = false;
+			break;
+		}
+		list_insert_ordered(&sema->waiters, &thread_current()->elem, cmp_thread_priority, NULL);
+		thread_block_until(until);
+	}
+	if (success)
+		sema->value--;
+	intr_set_level(old_level);
+	return success;
+}
+
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
    and wakes up one thread of those waiting for SEMA, if any.
 
@@ -115,8 +148,12 @@ void sema_up(struct semaphore *sema)
 	if (!list_empty(&sema->waiters)) // 대기 중인 스레드를 깨움
 	{
 		// waiters에 들어있는 스레드가 donate를 받아 우선순위가 달라졌을 수 있기 때문에 재정렬
+		struct thread *t;
+
 		list_sort(&sema->waiters, cmp_thread_priority, NULL);
-		thread_unblock(list_entry(list_pop_front(&sema->waiters), struct thread, elem));
+		t = list_entry(list_pop_front(&sema->waiters), struct thread, elem);
+		thread_cancel_timeout(t);
+		thread_unblock(t);
 	}
 	sema->value++;
 	preempt_priority(); // unblock이 호출되며 ready_list가 수정되었으므로 선점 여부 확인
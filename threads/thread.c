@@ -7,6 +7,7 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -294,6 +295,8 @@ void thread_exit(void)
 #ifdef USERPROG
 	process_exit();
 #endif
+	/* By now the process has released everything it owns. */
+	malloc_check_leaks("thread_exit", thread_current()->tid);
 
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
@@ -329,7 +332,7 @@ void thread_sleep(int64_t ticks)
 	ASSERT(curr != idle_thread); // 현재 스레드가 idle이 아닐 때만
 	curr->wakeup_ticks = ticks;	 // 일어날 시각 저장
 
-	list_insert_ordered(&sleep_list, &curr->elem, cmp_thread_ticks, NULL); // sleep_list에 추가
+	list_insert_ordered(&sleep_list, &curr->sleep_elem, cmp_thread_ticks, NULL); // sleep_list에 추가
 
 	thread_block(); // 현재 스레드 재우고 ready_list의 스레드 실행
 
@@ -344,11 +347,16 @@ void thread_wakeup(int64_t current_ticks)
 	struct list_elem *curr_elem = list_begin(&sleep_list); // sleep_list의 첫번째 요소(빈 경우 NULL)
 	while (curr_elem != list_end(&sleep_list))
 	{
-		struct thread *curr_thread = list_entry(curr_elem, struct thread, elem); // 현재 검사중인 elem의 스레드
+		struct thread *curr_thread = list_entry(curr_elem, struct thread, sleep_elem); // 현재 검사중인 elem의 스레드
 
 		if (current_ticks >= curr_thread->wakeup_ticks) // 깰 시간이 됐으면
 		{
 			curr_elem = list_remove(curr_elem); // sleep_list에서 제거 & curr_elem에는 다음 elem이 담김
+			if (curr_thread->timed_wait) // 세마포어 대기 시간 초과
+			{
+				list_remove(&curr_thread->elem);
+				curr_thread->timed_wait = false;
+			}
 			thread_unblock(curr_thread);		// ready_list로 이동
 			preempt_priority();
 		}
@@ -358,11 +366,42 @@ void thread_wakeup(int64_t current_ticks)
 	intr_set_level(old_level); // 인터럽트 상태를 원래 상태로 변경
 }
 
+/* Blocks the current thread, which the caller has put on a
+   semaphore wait list, until it is unblocked from there or the
+   timer reaches TICKS, whichever comes first.  In the latter case
+   it is taken off the wait list.  Interrupts must be off. */
+void thread_block_until(int64_t ticks)
+{
+	struct thread *curr = thread_current();
+
+	ASSERT(intr_get_level() == INTR_OFF);
+	ASSERT(curr != idle_thread);
+
+	curr->wakeup_ticks = ticks;
+	curr->timed_wait = true;
+	list_insert_ordered(&sleep_list, &curr->sleep_elem, cmp_thread_ticks, NULL);
+	thread_block();
+}
+
+/* Takes T, which is being woken from a semaphore wait list, off
+   the sleep list if it blocked with thread_block_until().
+   Interrupts must be off. */
+void thread_cancel_timeout(struct thread *t)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (t->timed_wait)
+	{
+		list_remove(&t->sleep_elem);
+		t->timed_wait = false;
+	}
+}
+
 // 두 스레드의 wakeup_ticks를 비교해서 작으면 true를 반환하는 함수
 bool cmp_thread_ticks(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
 {
-	struct thread *st_a = list_entry(a, struct thread, elem);
-	struct thread *st_b = list_entry(b, struct thread, elem);
+	struct thread *st_a = list_entry(a, struct thread, sleep_elem);
+	struct thread *st_b = list_entry(b, struct thread, sleep_elem);
 	return st_a->wakeup_ticks < st_b->wakeup_ticks;
 }
 
@@ -13,6 +13,7 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
@@ -183,6 +184,9 @@ __do_fork(void *aux)
 
 	process_activate(current);
 #ifdef VM
+	/* Resident-set limits are inherited, and kept across exec(). */
+	current->rss_soft = parent->rss_soft;
+	current->rss_hard = parent->rss_hard;
 	supplemental_page_table_init(&current->spt);
 	if (!supplemental_page_table_copy(&current->spt, &parent->spt))
 		goto error;
@@ -778,11 +782,9 @@ lazy_load_segment(struct page *page, void *aux)
 		return false;
 
 	/* Load this page. */
+	/* On failure the caller releases the frame. */
 	if (file_read(file, kpage, read_bytes) != (int)read_bytes)
-	{
-		palloc_free_page(kpage);
 		return false;
-	}
 	memset(kpage + read_bytes, 0, zero_bytes);
 
 	return true;
@@ -810,34 +812,24 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT(pg_ofs(upage) == 0);
 	ASSERT(ofs % PGSIZE == 0);
 
-	while (read_bytes > 0 || zero_bytes > 0)
-	{
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct lazy_load_arg *aux = NULL;
-		aux = (struct lazy_load_arg*)malloc(sizeof(struct lazy_load_arg));
-		aux->file = file;
-		aux->ofs = ofs;
-		aux->read_bytes = page_read_bytes;
-		aux->zero_bytes = page_zero_bytes;
-
-		if (!vm_alloc_page_with_initializer(VM_ANON, upage,
-											writable, lazy_load_segment, aux))
-			return false;
-
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
-		// [수정] 지우면 안 돌아감..
-		ofs += page_read_bytes;
-	}
-	return true;
+	/* The pages holding file contents become one file-backed VMA
+	 * and the rest, the BSS, an anonymous one of demand-zero
+	 * pages; each page is set up lazily on its first fault.  File
+	 * pages are shared by every process running this binary while
+	 * they are clean, and eviction just drops them.  Writable ones
+	 * are private: a write makes the page anonymous. */
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	size_t file_len = ROUND_UP(read_bytes, PGSIZE);
+	size_t zero_len = read_bytes + zero_bytes - file_len;
+
+	if (file_len > 0
+		&& !vma_map(spt, upage, file_len,
+					VM_FILE | (writable ? VM_FILE_PRIVATE : VM_FILE_SHARED),
+					writable, file, ofs, read_bytes))
+		return false;
+	return zero_len == 0
+		|| vma_map(spt, upage + file_len, zero_len, VM_ANON, writable,
+				   NULL, 0, 0);
 }
 
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
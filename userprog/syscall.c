@@ -1,6 +1,7 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
 #include <syscall-nr.h>
+#include <mman.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
@@ -35,6 +36,9 @@ int exec(const char *cmd_line);
 int wait(int pid);
 void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap(void *addr);
+int madvise(void *addr, size_t length, int advice);
+int msync(void *addr, size_t length, int flags);
+int rsslimit(size_t soft, size_t hard);
 
 /* System call.
  *
@@ -119,6 +123,15 @@ void syscall_handler(struct intr_frame *f UNUSED)
 	case SYS_MUNMAP:
 		munmap(f->R.rdi);
 		break;
+	case SYS_MADVISE:
+		f->R.rax = madvise((void *)f->R.rdi, f->R.rsi, f->R.rdx);
+		break;
+	case SYS_MSYNC:
+		f->R.rax = msync((void *)f->R.rdi, f->R.rsi, f->R.rdx);
+		break;
+	case SYS_RSSLIMIT:
+		f->R.rax = rsslimit(f->R.rdi, f->R.rsi);
+		break;
 	}
 }
 
@@ -246,7 +259,7 @@ int read(int fd, void *buffer, unsigned size)
 		체크한 값에 대해 지금 write 할려는 시도가 가능하지 않다면 리턴*/
 
 		struct supplemental_page_table *spt = &thread_current()->spt;
-		struct page *p = spt_find_page(spt, buffer);
+		struct page *p = vma_get_page(spt, buffer);
 		if (p != NULL && !p->writable)
 		{
 			lock_release(&filesys_lock);
@@ -332,13 +345,29 @@ void *mmap(void *addr, size_t length, int writable, int fd, off_t offset)
 		return NULL;
 	if (addr != pg_round_down(addr))
 		return NULL;
-	if (spt_find_page(&thread_current()->spt, addr))
-		return NULL;
-
-	return do_mmap(addr, length, writable, file, offset);
+	/* MAP_POPULATE: 모든 페이지를 미리 읽어 둔다. */
+	void *map = do_mmap(addr, length, writable & ~MAP_POPULATE, file, offset);
+	if (map != NULL && (writable & MAP_POPULATE))
+		do_madvise(map, length, MADV_WILLNEED);
+	return map;
 }
 
 void munmap(void *addr)
 {
 	do_munmap(addr);
 }
+
+int madvise(void *addr, size_t length, int advice)
+{
+	return do_madvise(addr, length, advice) ? 0 : -1;
+}
+
+int msync(void *addr, size_t length, int flags)
+{
+	return do_msync(addr, length, flags) ? 0 : -1;
+}
+
+int rsslimit(size_t soft, size_t hard)
+{
+	return do_rsslimit(soft, hard) ? 0 : -1;
+}
@@ -1,7 +1,11 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #include "devices/disk.h"
+#include "threads/malloc.h"
+#include <bitmap.h>
+#include <mman.h>
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -17,33 +21,197 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* Swap slots.  Slot N holds one page in sectors
+ * [N * SECTORS_PER_SLOT, (N + 1) * SECTORS_PER_SLOT) of the swap
+ * disk; SWAP_MAP has a bit set for each slot in use.  An anonymous
+ * page that is swapped out remembers its slot in struct anon_page.
+ * After fork() the parent's and the child's page may refer to the
+ * same slot; SLOT_REFS counts them, and a slot is never rewritten
+ * while it is referenced. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+#define NO_SLOT BITMAP_ERROR
+
+static struct bitmap *swap_map;
+static struct page **slot_pages; /* Page whose contents each slot holds. */
+static uint16_t *slot_refs;     /* Pages referring to each slot. */
+static size_t swap_hint;        /* Where the next search starts. */
+static struct lock swap_lock;   /* Protects the variables above. */
+
+/* Swap readahead.  Pages swapped out together tend to be needed
+ * together, so a swap-in also reads up to RA_WINDOW following
+ * slots that hold pages of the same process, in the same
+ * transfer.  Those pages stay in the swap cache: they have a frame
+ * but are not mapped, and keep their slot, until they fault (a
+ * hit, mapped without I/O) or are evicted unused (a miss, dropped
+ * without I/O).  Each hit widens the window and each miss narrows
+ * it.  Protected by SWAP_LOCK. */
+#define RA_MAX_WINDOW (SWAP_CLUSTER / 2)
+static size_t ra_window = 2;
+
+static size_t swap_slots_alloc (size_t cnt);
+static void swap_slot_put (size_t slot, struct page *page);
+static size_t swap_reclaim_cached (void);
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
 	/* TODO: Set up the swap_disk. */
-	/* 
-		1. swap disk 생성 -> disk_get(1, 1)
-		2. disk_size로 sector 개수가 몇 개 있는지 확인
-		3. slot 구조체 생성->page, swap-elem, slot-number
-		4. swap table에 빈 슬롯을 다 넣어줌
-		5. list_init swap_table 해줌
-		6. list_init frame_table 해줌 */
-	swap_disk = NULL;
-	swap_disk = disk_get(1, 1);
+	size_t slot_cnt = 0;
 
-	/* disk size에 따라 sector 몇 개 있는지 확인후 list에 집어넣기 */
-	list_init(&swap_table);
+	swap_disk = disk_get(1, 1);
+	if (swap_disk != NULL)
+		slot_cnt = disk_size(swap_disk) / SECTORS_PER_SLOT;
+	void *buf = malloc_tagged(bitmap_buf_size(slot_cnt), MT_VM_SWAP);
+	if (buf == NULL)
+		PANIC("vm: cannot allocate swap map for %zu slots", slot_cnt);
+	swap_map = bitmap_create_in_buf(slot_cnt, buf, bitmap_buf_size(slot_cnt));
+	slot_pages = malloc_tagged(slot_cnt * sizeof *slot_pages, MT_VM_SWAP);
+	if (slot_pages == NULL && slot_cnt > 0)
+		PANIC("vm: cannot allocate swap map for %zu slots", slot_cnt);
+	memset(slot_pages, 0, slot_cnt * sizeof *slot_pages);
+	slot_refs = malloc_tagged(slot_cnt * sizeof *slot_refs, MT_VM_SWAP);
+	if (slot_refs == NULL && slot_cnt > 0)
+		PANIC("vm: cannot allocate swap map for %zu slots", slot_cnt);
+	memset(slot_refs, 0, slot_cnt * sizeof *slot_refs);
 	lock_init(&swap_lock);
+	zswap_init();
+}
+
+/* Allocates CNT consecutive free swap slots, each with one
+ * reference, and returns the first one's number, or NO_SLOT if
+ * there is no such run.  Searching
+ * resumes after the run handed out last, so a mostly full disk is
+ * not rescanned from the start every time, and successive runs
+ * tend to be adjacent on disk. */
+static size_t
+swap_slots_alloc (size_t cnt) {
+	size_t slot;
+
+	lock_acquire(&swap_lock);
+	slot = bitmap_scan_and_flip(swap_map, swap_hint, cnt, false);
+	if (slot == BITMAP_ERROR && swap_hint != 0)
+		slot = bitmap_scan_and_flip(swap_map, 0, cnt, false);
+	if (slot == BITMAP_ERROR && swap_reclaim_cached() > 0)
+		slot = bitmap_scan_and_flip(swap_map, 0, cnt, false);
+	if (slot != BITMAP_ERROR) {
+		swap_hint = slot + cnt < bitmap_size(swap_map) ? slot + cnt : 0;
+		for (size_t i = 0; i < cnt; i++)
+			slot_refs[slot + i] = 1;
+	}
+	lock_release(&swap_lock);
+	return slot;
+}
+
+/* Drops the references that resident, mapped pages hold to their
+ * slots, which were kept so that evicting those pages while clean
+ * needs no write.  Called when swap runs out.  A frame shared
+ * copy-on-write keeps its slot, which all its pages refer to.
+ * Returns the number of slots freed.  SWAP_LOCK must be held, and
+ * so must the frame table lock, which keeps the frames checked
+ * here from changing. */
+static size_t
+swap_reclaim_cached (void) {
+	size_t freed = 0;
+
+	for (size_t slot = 0; slot < bitmap_size(swap_map); slot++) {
+		struct page *page = slot_pages[slot];
+		if (page == NULL || page->frame == NULL || page->frame->pin_cnt > 0
+				|| page->frame->ref_cnt > 1 || page->anon.readahead)
+			continue;
+		page->anon.slot = NO_SLOT;
+		slot_pages[slot] = NULL;
+		if (--slot_refs[slot] == 0) {
+			bitmap_reset(swap_map, slot);
+			freed++;
+		}
+	}
+	return freed;
+}
+
+/* Drops PAGE's reference to SLOT, returning the slot to the free
+ * pool with the last one. */
+static void
+swap_slot_put (size_t slot, struct page *page) {
+	lock_acquire(&swap_lock);
+	ASSERT(bitmap_test(swap_map, slot) && slot_refs[slot] > 0);
+	if (slot_pages[slot] == page)
+		slot_pages[slot] = NULL;
+	if (--slot_refs[slot] == 0)
+		bitmap_reset(swap_map, slot);
+	lock_release(&swap_lock);
+}
+
+/* Adjusts the readahead window after a hit (HIT is true) or a
+ * wasted read. */
+static void
+ra_feedback (bool hit) {
+	lock_acquire(&swap_lock);
+	if (hit && ra_window < RA_MAX_WINDOW)
+		ra_window++;
+	else if (!hit && ra_window > 1)
+		ra_window--;
+	lock_release(&swap_lock);
+}
+
+/* Returns true if PAGE, found in a slot following the one being
+ * swapped in, may be read ahead along with it: it must be a
+ * swapped-out page of the current process.  SWAP_LOCK must be
+ * held. */
+static bool
+ra_candidate (struct page *page) {
+	return page != NULL && page->frame == NULL
+		&& spt_find_page(&thread_current()->spt, page->va) == page;
+}
+
+/* Returns true if PAGE's contents are also in a swap slot, so that
+ * evicting it needs no write: it was read ahead and never mapped,
+ * or it was swapped in and has not been written to since.  PAGE
+ * must be resident.  Only trustworthy once PAGE is unmapped. */
+bool
+anon_has_swap_copy (struct page *page) {
+	if (page_get_type(page) != VM_ANON || page->anon.slot == NO_SLOT)
+		return false;
+	return page->anon.readahead
+		|| !pml4_is_dirty(page->owner->pml4, page->va);
+}
+
+/* Returns true if PAGE, a resident page, is an anonymous page
+ * that is in no swap slot and not in the swap cache, so that its
+ * frame may be exchanged for another with the same contents. */
+bool
+anon_mergeable (struct page *page) {
+	return page->operations->type == VM_ANON
+		&& page->anon.slot == NO_SLOT && !page->anon.readahead
+		&& page->anon.zentry == NULL;
+}
+
+/* Sets up DST, a new page of a fork() child, as an anonymous page
+ * and gives it a reference to the swap slot of SRC, the parent's
+ * page at the same address, if that slot is up to date, or a copy
+ * of SRC's compressed contents in zswap.  A slot SRC has outdated
+ * by writing is dropped here, so that all pages sharing a frame
+ * copy-on-write agree on its slot.  Returns false if zswap has no
+ * room for the copy.  The frame table lock must be held. */
+bool
+anon_fork (struct page *dst, struct page *src) {
+	size_t slot = src->anon.slot;
 
-	disk_sector_t size = disk_size(swap_disk); //sector size
-	/* swap_table에 slot 넣어 주기 */
-	for (int i = 0; i < size; i = i + 8)
-	{
-		struct slot *new_slot = (struct slot *)malloc(sizeof(struct slot));
-		new_slot->page = NULL;
-		new_slot->slot_number = i / 8; // sector size로 나눠 줌
-		list_push_back(&swap_table, &new_slot->swap_elem);
+	anon_initializer(dst, VM_ANON, NULL);
+	if (src->anon.zentry != NULL)
+		return zswap_dup(dst, src);
+	if (slot == NO_SLOT)
+		return true;
+	if (src->frame != NULL && !anon_has_swap_copy(src)) {
+		swap_slot_put(slot, src);
+		src->anon.slot = NO_SLOT;
+		return true;
 	}
+	lock_acquire(&swap_lock);
+	ASSERT(slot_refs[slot] < UINT16_MAX);
+	slot_refs[slot]++;
+	lock_release(&swap_lock);
+	dst->anon.slot = slot;
+	return true;
 }
 
 /* Initialize the file mapping */
@@ -54,85 +222,215 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+	anon_page->slot = NO_SLOT;
+	anon_page->readahead = false;
+	anon_page->zentry = NULL;
 	return true;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Swap in the page by read contents from the swap disk.
+ * A page read ahead earlier is already in KVA, and a page in
+ * zswap is decompressed without I/O.
+ * The slot is kept as long as the page stays clean; see
+ * anon_has_swap_copy(). */
 static bool
 anon_swap_in (struct page *page, void *kva) {
-	struct list_elem *e;
-	struct slot *s;
 	struct anon_page *anon_page = &page->anon;
-	/* frame에 있는 page와 frame을 연결해 준다 */
-	lock_acquire(&swap_lock);
-	for (e = list_begin (&swap_table); e != list_end (&swap_table); e = list_next (e)) {
-		/* swap_table을 돌면서 리스트 안의 페이지가 현재 찾는 페이지인지 확인 */
-		s = list_entry(e, struct slot, swap_elem);
-		if (s->page == page)
-		{
-			struct thread *t = thread_current();
-
-			// 다시 frame table에 해당 frame을 올림
-			// list_push_back(&frame_table, &page->frame->frame_elem);
-			// swap disk의 sector num부터 한 페이지를 읽어 옴
-			disk_sector_t sector_num = (s->slot_number) * 8;
-			void *addr = kva;
-
-			for (int i = sector_num; i < sector_num + 8; i++)
-			{
-				disk_read(swap_disk, i, addr);
-				addr += DISK_SECTOR_SIZE;
-			}
-			s->page = NULL;
+	struct disk_iovec iov[1 + RA_MAX_WINDOW];
+	struct page *ra_pages[RA_MAX_WINDOW];
+	size_t ra_cnt = 0, window;
+
+	if (zswap_load(page, kva))
+		return true;
+	if (anon_page->slot == NO_SLOT)
+		return false;
+
+	if (anon_page->readahead) {
+		ASSERT(page->frame != NULL && page->frame->kva == kva);
+		ra_feedback(true);
+	} else {
+		/* Collect the run of following slots worth reading too,
+		 * each with a frame that is free right now; readahead
+		 * never evicts. */
+		zswap_miss();
+		iov[0] = (struct disk_iovec){ .buf = kva, .sec_cnt = SECTORS_PER_SLOT };
+		lock_acquire(&swap_lock);
+		window = ra_window;
+		lock_release(&swap_lock);
+		if (vma_advice(page) == MADV_RANDOM)
+			window = 0;
+		while (ra_cnt < window
+				&& anon_page->slot + 1 + ra_cnt < bitmap_size(swap_map)) {
+			struct page *next;
+			struct frame *frame;
+
+			lock_acquire(&swap_lock);
+			next = slot_pages[anon_page->slot + 1 + ra_cnt];
+			if (!ra_candidate(next))
+				next = NULL;
 			lock_release(&swap_lock);
-			return true;
+			if (next == NULL || (frame = vm_get_free_frame(next)) == NULL)
+				break;
+			ra_pages[ra_cnt] = next;
+			iov[1 + ra_cnt++] = (struct disk_iovec){
+				.buf = frame->kva, .sec_cnt = SECTORS_PER_SLOT };
+		}
+
+		/* Slots are not rewritten while referenced, so no lock
+		 * is needed for the I/O. */
+		disk_readv(swap_disk, anon_page->slot * SECTORS_PER_SLOT, iov,
+				1 + ra_cnt);
+
+		for (size_t i = 0; i < ra_cnt; i++) {
+			ra_pages[i]->anon.readahead = true;
+			vm_unpin_frame(ra_pages[i]->frame);
 		}
 	}
-	lock_release(&swap_lock);
-	return false;
+
+	anon_page->readahead = false;
+	return true;
 }
 
-/* Swap out the page by writing contents to the swap disk. */
+/* Swap out the page by writing contents to the swap disk.
+ * Returns false, leaving the page in memory, if swap is full.
+ * A page whose slot still holds its contents is dropped without
+ * I/O. */
 static bool
 anon_swap_out (struct page *page) {
-	struct list_elem *e;
-	struct slot *s;
-	struct anon_page *anon_page = &page->anon;
-	/* swap table의 빈 곳 찾기 -> page 할당 -> slot num 찾아 disk_write 하기 */
-	lock_acquire(&swap_lock);
-	for (e = list_begin (&swap_table); e != list_end (&swap_table); e = list_next (e)) {
-		/* swap_table을 돌면서 리스트 안의 페이지가 NULL인지 확인 */
-		s = list_entry(e, struct slot, swap_elem);
-		/* slot_num을 통해 sector num을 계산 */
-		if (s->page == NULL)
-		{
-			disk_sector_t sector_num = (s->slot_number) * 8;
-			/* disk_write으로 해당 슬롯에 page를 써 줌 */
-			char *addr = page->frame->kva;
-			for (int i = sector_num; i < sector_num + 8; i++)
-			{
-				disk_write(swap_disk, i, addr);
-				addr += DISK_SECTOR_SIZE;
-			}
-			// [수정] slot의 page를 추가해 주기
-			s->page = page;
-			break;
+	if (anon_has_swap_copy(page)) {
+		if (page->anon.readahead) {
+			page->anon.readahead = false;
+			ra_feedback(false);
+		}
+		return true;
+	}
+	return anon_swap_out_cluster(&page, 1);
+}
+
+/* Swaps out the CNT resident anonymous pages in PAGES.  Those
+ * that compress well go to zswap; the others are written to one
+ * run of consecutive swap slots, in a single disk transfer, so
+ * that eviction under pressure produces large sequential writes.
+ * Returns false, swapping out nothing, if no free run of slots
+ * exists for them.  The caller has unmapped the pages, marked their
+ * frames busy and holds the frame table lock, which is dropped for
+ * the write; it unlinks the frames afterward. */
+bool
+anon_swap_out_cluster (struct page *pages[], size_t cnt) {
+	struct disk_iovec iov[SWAP_CLUSTER];
+	struct page *disk_pages[SWAP_CLUSTER];
+	size_t disk_cnt = 0, slot;
+
+	ASSERT(cnt >= 1 && cnt <= SWAP_CLUSTER);
+
+	/* Slots kept from an earlier swap-in hold stale contents. */
+	for (size_t i = 0; i < cnt; i++)
+		if (pages[i]->anon.slot != NO_SLOT) {
+			swap_slot_put(pages[i]->anon.slot, pages[i]);
+			pages[i]->anon.slot = NO_SLOT;
 		}
+
+	for (size_t i = 0; i < cnt; i++)
+		if (!zswap_store(pages[i], pages[i]->frame->kva))
+			disk_pages[disk_cnt++] = pages[i];
+	if (disk_cnt == 0)
+		return true;
+
+	slot = swap_slots_alloc(disk_cnt);
+	if (slot == NO_SLOT) {
+		for (size_t i = 0; i < cnt; i++)
+			zswap_free(pages[i]);
+		return false;
 	}
+
+	lock_acquire(&swap_lock);
+	for (size_t i = 0; i < disk_cnt; i++)
+		slot_pages[slot + i] = disk_pages[i];
 	lock_release(&swap_lock);
-	/* 만약 끝까지 탐색했는데 swap table에 자리가 없는 경우 */
-	if (e == list_end(&swap_table))
-	{
-		PANIC("TODO");
+
+	for (size_t i = 0; i < disk_cnt; i++) {
+		ASSERT(page_get_type(disk_pages[i]) == VM_ANON);
+		ASSERT(!disk_pages[i]->anon.readahead);
+		iov[i].buf = disk_pages[i]->frame->kva;
+		iov[i].sec_cnt = SECTORS_PER_SLOT;
+		disk_pages[i]->anon.slot = slot + i;
+	}
+	vm_io_unlock();
+	disk_writev(swap_disk, slot * SECTORS_PER_SLOT, iov, disk_cnt);
+	vm_io_relock();
+	return true;
+}
+
+/* Writes the page at BUF to a new swap slot, which it stores in
+ * *SLOT, for anon_swap_attach() to give to a page.  Used by zswap
+ * to write pages back.  Returns false if swap is full.  The frame
+ * table lock must be held, as for any slot allocation; it is
+ * dropped for the write. */
+bool
+anon_swap_write (const void *buf, size_t *slot) {
+	struct disk_iovec iov = { .buf = (void *) buf, .sec_cnt = SECTORS_PER_SLOT };
+
+	*slot = swap_slots_alloc(1);
+	if (*slot == NO_SLOT)
 		return false;
+	vm_io_unlock();
+	disk_writev(swap_disk, *slot * SECTORS_PER_SLOT, &iov, 1);
+	vm_io_relock();
+	return true;
+}
+
+/* Gives SLOT, written by anon_swap_write(), to PAGE, a swapped-out
+ * anonymous page without a slot, or frees it if PAGE is NULL. */
+void
+anon_swap_attach (struct page *page, size_t slot) {
+	if (page == NULL) {
+		swap_slot_put(slot, NULL);
+		return;
 	}
+	ASSERT(page->anon.slot == NO_SLOT);
+	lock_acquire(&swap_lock);
+	slot_pages[slot] = page;
+	lock_release(&swap_lock);
+	page->anon.slot = slot;
+}
 
-	/* frame-page 연결 끊기 */
-	page->frame->page = NULL;
-	page->frame = NULL;
-	/* pml4_clear */
-	pml4_clear_page(thread_current()->pml4, page->va);
-	
+/* Writes FRAME, which several anonymous pages share copy-on-write
+ * and which the caller has unmapped from all of them, to swap.
+ * The pages were write-protected all along, so if they have a slot
+ * it is up to date and nothing needs writing; otherwise one slot is
+ * written and all of them refer to it.  Returns false if swap is
+ * full.  As for anon_swap_out_cluster(), FRAME is busy and the
+ * frame table lock is dropped for the write.  The caller unlinks
+ * the pages from FRAME. */
+bool
+anon_swap_out_shared (struct frame *frame) {
+	struct page *first = list_entry(list_front(&frame->pages),
+			struct page, rmap_elem);
+	struct disk_iovec iov = { .buf = frame->kva, .sec_cnt = SECTORS_PER_SLOT };
+	struct list_elem *e;
+	size_t slot;
+
+	if (first->anon.slot != NO_SLOT)
+		return true;
+
+	slot = swap_slots_alloc(1);
+	if (slot == NO_SLOT)
+		return false;
+	lock_acquire(&swap_lock);
+	slot_pages[slot] = first;
+	slot_refs[slot] = frame->ref_cnt;
+	lock_release(&swap_lock);
+
+	for (e = list_begin(&frame->pages); e != list_end(&frame->pages);
+			e = list_next(e)) {
+		struct page *page = list_entry(e, struct page, rmap_elem);
+		ASSERT(page_get_type(page) == VM_ANON);
+		ASSERT(page->anon.slot == NO_SLOT);
+		page->anon.slot = slot;
+	}
+	vm_io_unlock();
+	disk_writev(swap_disk, slot * SECTORS_PER_SLOT, &iov, 1);
+	vm_io_relock();
 	return true;
 }
 
@@ -140,4 +438,11 @@ anon_swap_out (struct page *page) {
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
-}
\ No newline at end of file
+
+	if (anon_page->slot != NO_SLOT) {
+		swap_slot_put(anon_page->slot, page);
+		anon_page->slot = NO_SLOT;
+	}
+	zswap_free(page);
+	anon_page->readahead = false;
+}
@@ -1,6 +1,8 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include "devices/disk.h"
+#include "threads/malloc.h"
 #include "userprog/process.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
@@ -32,6 +34,8 @@ file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
 	file_page->file_ofs = arg->ofs;
 	file_page->read_bytes = arg->read_bytes;
 	file_page->zero_bytes = arg->zero_bytes;
+	file_page->shared = (type & VM_FILE_SHARED) != 0;
+	file_page->private = (type & VM_FILE_PRIVATE) != 0;
 
 	return true;
 }
@@ -75,26 +79,98 @@ file_backed_swap_in (struct page *page, void *kva) {
 	// memset(kpage + read_bytes, 0, zero_bytes);
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file.
+ * Called during eviction, which has marked the frame busy and
+ * holds the frame table lock; the lock is dropped for the write. */
 static bool
 file_backed_swap_out (struct page *page) {
+	vm_io_unlock();
 	file_backed_destroy(page);
+	vm_io_relock();
 	return true;
 }
 
-/* Destory the file backed page. PAGE will be freed by the caller. */
+/* Destory the file backed page. PAGE will be freed by the caller.
+ * Unmapping the page is left to the caller, which may batch the
+ * TLB invalidations; the contents are therefore written back
+ * through the frame's kernel address, not PAGE->va. */
 static void
 file_backed_destroy (struct page *page) {
-	struct supplemental_page_table *spt = &thread_current()->spt;
 	struct file_page *arg = &page->file;
-		if (pml4_is_dirty(thread_current()->pml4, page->va)){
-			/* 어떤 offset부터 썼는지 확인 후 그 offset부터 write */
-			file_write_at(arg->file, page->va, arg->read_bytes, arg->file_ofs);
-			/* dirty bit 0으로 set */
-			pml4_set_dirty(thread_current()->pml4, page->va, 0);
+
+	if (page->frame == NULL || arg->private)
+		return;
+	uint64_t *pml4 = page->owner->pml4;
+	if (pml4_is_dirty(pml4, page->va)){
+		/* 어떤 offset부터 썼는지 확인 후 그 offset부터 write */
+		file_write_at(arg->file, page->frame->kva, arg->read_bytes, arg->file_ofs);
+		/* dirty bit 0으로 set */
+		pml4_set_dirty(pml4, page->va, 0);
+	}
+}
+
+/* Returns true if PAGE is a resident page of a mapped file with
+ * changes not yet written back.  The frame table lock must be
+ * held. */
+bool
+file_backed_dirty (struct page *page) {
+	return page->operations->type == VM_FILE && !page->file.shared
+		&& !page->file.private && page->frame != NULL
+		&& pml4_is_dirty (page->owner->pml4, page->va);
+}
+
+/* Returns true if PAGE, which may not be loaded yet, belongs to a
+ * private file mapping and has not been written, so that it must
+ * be mapped read-only. */
+bool
+file_backed_private (struct page *page) {
+	if (VM_TYPE (page->operations->type) == VM_UNINIT)
+		return (page->uninit.type & VM_FILE_PRIVATE) != 0;
+	return page->operations->type == VM_FILE && page->file.private;
+}
+
+/* Writes back the CNT pages in PAGES, dirty pages of mapped files
+ * sorted by file and offset, and marks them clean.  Each run of
+ * whole pages at consecutive offsets of one file goes out in one
+ * disk transfer.  The caller has marked the pages' frames pinned
+ * and busy, so that they cannot go away, and need not hold the
+ * frame table lock.
+ *
+ * The dirty bits are cleared before the writes, so that a store
+ * made while they are in progress dirties the page again. */
+void
+file_backed_writeback (struct page *pages[], size_t cnt) {
+	struct disk_iovec iov[FILE_WB_MAX];
+	size_t i, n;
+
+	ASSERT (cnt <= FILE_WB_MAX);
+
+	for (i = 0; i < cnt; i++)
+		pml4_set_dirty (pages[i]->owner->pml4, pages[i]->va, false);
+
+	for (i = 0; i < cnt; i += n) {
+		struct file_page *first = &pages[i]->file;
+		struct inode *inode = file_get_inode (first->file);
+
+		for (n = 0; i + n < cnt; n++) {
+			struct file_page *fp = &pages[i + n]->file;
+
+			if (fp->read_bytes != PGSIZE || file_get_inode (fp->file) != inode
+					|| fp->file_ofs != first->file_ofs + (off_t) n * PGSIZE)
+				break;
+			iov[n] = (struct disk_iovec) {
+				.buf = pages[i + n]->frame->kva,
+				.sec_cnt = PGSIZE / DISK_SECTOR_SIZE };
 		}
-	pml4_clear_page(thread_current()->pml4, page->va);
-	// struct file_page *file_page UNUSED = &page->file;
+		if (n > 0 && file_writev_at (first->file, iov, n, first->file_ofs))
+			continue;
+
+		/* A partial last page, or a run that did not fit. */
+		n = n > 0 ? n : 1;
+		for (size_t j = i; j < i + n; j++)
+			file_write_at (pages[j]->file.file, pages[j]->frame->kva,
+					pages[j]->file.read_bytes, pages[j]->file.file_ofs);
+	}
 }
 
 /* Do the mmap */
@@ -105,69 +181,54 @@ do_mmap (void *addr, size_t length, int writable,
 			or length가 0일 때
 			addr이 page-aligned되지 않았거나,
 			기존 매핑된 페이지 집합(실행가능 파일이 동작하는 동안 매핑된 스택 또는 페이지를 포함)과 겹치는 경우 실패해야 합니다. 
-			-> length도 확인하고, spt_find_page로 page를 찾는다.
+			-> 범위 전체가 겹치는지는 vma_map()이 확인한다.
 			*/
 			/* 파일의 오프셋 바이트부터 length 만큼을 프로세스의 가상주소공간의 addr에 매핑*/
-			/* 한 페이지만큼을 읽고 가상주소에 매핑 -> 페이지 새로 만들기 */
-			struct file *f = file_reopen(file);
-			uint32_t read_bytes = length > file_length(f)? file_length(f) : length;
-			uint32_t zero_bytes = PGSIZE - read_bytes % PGSIZE;
-			int total_page_count = length <= PGSIZE ? 1 : length % PGSIZE ? length / PGSIZE + 1
-																  : length / PGSIZE; // 이 매핑을 위해 사용한 총 페이지 수
+			/* 페이지는 만들지 않고 VMA 하나만 등록한다.
+			페이지는 처음 접근할 때 vma_get_page()가 만든다. */
+			off_t file_len = file_length(file);
+			size_t read_bytes = offset < file_len ? (size_t)(file_len - offset) : 0;
+
+			if (read_bytes > length)
+				read_bytes = length;
+			if (!vma_map(&thread_current()->spt, addr, length, VM_FILE,
+						 writable, file, offset, read_bytes))
+				return NULL;
 			/* 시작 주소를 return해야 한다. */
-			void *ret_val = addr;
-
-			while (read_bytes > 0 || zero_bytes > 0)
-			{
-				/* Do calculate how to fill this page.
-				* We will read PAGE_READ_BYTES bytes from FILE
-				* and zero the final PAGE_ZERO_BYTES bytes. */
-				size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-				size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-				struct lazy_load_arg *aux = NULL;
-				aux = (struct lazy_load_arg*)malloc(sizeof(struct lazy_load_arg));
-				aux->file = f;
-				aux->ofs = offset;
-				aux->read_bytes = page_read_bytes;
-				aux->zero_bytes = page_zero_bytes;
-
-				if (!vm_alloc_page_with_initializer(VM_FILE, addr,
-													writable, lazy_load_segment, aux))
-					return NULL;
-
-				struct page *p = spt_find_page(&thread_current()->spt, addr);
-				p->page_cnt = total_page_count;
-				
-				/* Advance. */
-				read_bytes -= page_read_bytes;
-				zero_bytes -= page_zero_bytes;
-				addr += PGSIZE;
-				offset += page_read_bytes;
-			}
-			return ret_val;
+			return addr;
 }
 
 /* Do the munmap */
 void
 do_munmap (void *addr) {
-	// page의 전체 길이 -> spt_find_page로 해당 addr를 찾아 그 페이지 구조체의 길이 얻어오기
-	struct page *page = spt_find_page(&thread_current()->spt, addr);
-	off_t page_cnt = page->page_cnt;
-	
+	// 매핑의 전체 길이 -> addr에서 시작하는 VMA에서 얻어오기
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	struct vma *vma = vma_find(spt, addr);
+	struct page *page;
+	struct tlb_gather tlb;
+
+	/* 실행 파일의 세그먼트는 munmap할 수 없다. */
+	if (vma == NULL || vma->start != addr || vma->type != VM_FILE)
+		return;
+
 	/* 변경된 파일은 쓴 후, dirty bit 원래대로 돌려주기
 	spt 테이블에서 삭제하고 pml4 테이블에서 삭제*/
-	for (int i = 0; i < page_cnt; i++)
+	/* First write back and unmap every page, with one batched
+	 * TLB flush, then free the pages and their frames: a frame
+	 * must not be reused while a stale TLB entry may point at it. */
+	tlb_gather_init(&tlb, thread_current()->pml4, false);
+	for (page = spt_next_page(spt, addr); page != NULL && page->va < vma->end;
+		 page = spt_next_page(spt, page->va + PGSIZE))
+		vm_unmap_gather(&tlb, page);
+	tlb_gather_finish(&tlb);
+
+	page = spt_next_page(spt, addr);
+	while (page != NULL && page->va < vma->end)
 	{
-		addr += PGSIZE;
-		if (page)
-		{
-			/* spt_remove_page -> vm_dealloc_page -> destroy(file_destroy)순으로 호출 */
-			/* [?] remove_page 대신 destroy로 해야 작동이 된다. */
-			destroy(page);
-			// spt_remove_page(&thread_current()->spt, page);		
-		}
-		page = spt_find_page(&thread_current()->spt, addr);
+		void *next = page->va + PGSIZE;
+
+		spt_remove_page(spt, page);
+		page = spt_next_page(spt, next);
 	}
-	
+	vma_unmap(spt, vma);
 }
\ No newline at end of file
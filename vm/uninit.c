@@ -10,6 +10,7 @@
 
 #include "vm/vm.h"
 #include "vm/uninit.h"
+#include "threads/malloc.h"
 
 static bool uninit_initialize (struct page *page, void *kva);
 static void uninit_destroy (struct page *page);
@@ -42,7 +43,9 @@ uninit_new (struct page *page, void *va, vm_initializer *init,
 	};
 }
 
-/* Initalize the page on first fault */
+/* Initalize the page on first fault.  AUX, which the page owns,
+ * is freed once the page has been transmuted, whether or not
+ * loading it succeeds: the page is no longer uninit either way. */
 static bool
 uninit_initialize (struct page *page, void *kva) {
 	struct uninit_page *uninit = &page->uninit;
@@ -50,10 +53,27 @@ uninit_initialize (struct page *page, void *kva) {
 	/* Fetch first, page_initialize may overwrite the values */
 	vm_initializer *init = uninit->init;
 	void *aux = uninit->aux;
+	bool ok;
 
 	/* TODO: You may need to fix this function. */
-	return uninit->page_initializer (page, uninit->type, kva) &&
+	ok = uninit->page_initializer (page, uninit->type, kva) &&
 		(init ? init (page, aux) : true);
+	free (aux);
+	return ok;
+}
+
+/* Transmutes PAGE like uninit_initialize(), but without calling
+ * its initialization callback: the caller has filled KVA with the
+ * page's contents already, e.g. for fault-around. */
+bool
+uninit_transmute (struct page *page, void *kva) {
+	struct uninit_page *uninit = &page->uninit;
+	void *aux = uninit->aux;
+	bool ok;
+
+	ok = uninit->page_initializer (page, uninit->type, kva);
+	free (aux);
+	return ok;
 }
 
 /* Free the resources hold by uninit_page. Although most of pages are transmuted
@@ -62,11 +82,9 @@ uninit_initialize (struct page *page, void *kva) {
  * PAGE will be freed by the caller. */
 static void
 uninit_destroy (struct page *page) {
-	struct uninit_page *uninit UNUSED = &page->uninit;
+	struct uninit_page *uninit = &page->uninit;
 	/* TODO: Fill this function.
 	 * TODO: If you don't have anything to do, just return. */
-	// free(uninit->type);
-	// free(uninit->aux);
-	// free(uninit->init);
-	// free(uninit->page_initializer);
+	free (uninit->aux);
+	uninit->aux = NULL;
 }
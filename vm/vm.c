@@ -1,12 +1,170 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <mman.h>
+#include <round.h>
+#include <stdio.h>
 #include "threads/malloc.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 #include "userprog/process.h"
+#include "devices/disk.h"
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
 
 #define USER_STK_LIMIT (1 << 20)
 
+/* Frame table.  FRAME_TABLE[i] describes the i'th page of the
+ * user pool, so finding the frame of a kernel address is a
+ * subtraction, and the clock hand is just an index.  FRAME_LOCK
+ * protects the table.  It is held while choosing and unmapping
+ * victims and allocating their swap slots, but not across disk
+ * I/O; see below. */
+static struct frame *frame_table;
+static size_t frame_cnt;
+static uint8_t *frame_base;
+static size_t clock_hand;
+static struct lock frame_lock;
+
+/* In-flight I/O.  Eviction marks the frames it writes out pinned
+ * and busy (IO) and drops FRAME_LOCK for the write, and so does a
+ * fault that reads a file block into a frame it has already entered
+ * in the page cache.  A busy frame is taken away from everyone
+ * else: whoever finds one, through a page or the page cache, waits
+ * on IO_DONE and then looks again, so that concurrent faults on
+ * one page or one file block share a single transfer, and a fault
+ * waiting on the disk holds up no other process.  IO_DONE is used
+ * with FRAME_LOCK. */
+static struct condition io_done;
+
+/* Fault-around.  A read fault on a page loaded from a file also
+ * loads up to FA_WINDOW following pages that come from the next
+ * blocks of the same file and are not resident yet, in one disk
+ * transfer, and maps them, so the program takes no fault on them.
+ * Only frames that are free right now are used.  A page mapped
+ * this way is a hit if it has been accessed the first time it is
+ * looked at again, by the clock or when it is unmapped, and a miss
+ * otherwise; each hit widens the window and each miss narrows it.
+ * Protected by FRAME_LOCK. */
+#define FA_MAX_WINDOW 16
+static size_t fa_window = 4;
+
+/* Page cache.  A frame holding a block of a file that cannot
+ * change while mapped, such as executable text (VM_FILE_SHARED)
+ * or a clean page of initialized data (VM_FILE_PRIVATE), is
+ * entered in FRAME_CACHE under the block's inode, offset and
+ * length.  Every process that maps the block then maps that one
+ * frame read-only instead of reading its own copy.  The frame
+ * leaves the cache, dropping its reference to the inode, when its
+ * last page goes.  Protected by FRAME_LOCK. */
+static struct hash frame_cache;
+
+/* The zero frame: one page of zeros, from the kernel pool and not
+ * in the frame table, that every anonymous page read before it is
+ * ever written maps read-only.  The first write takes the
+ * copy-on-write path to a private frame, so untouched BSS, stack
+ * and sparse arrays cost no memory.  It is never evicted or freed;
+ * its list of pages is protected by FRAME_LOCK. */
+static struct frame zero_frame;
+
+/* Background reclaim.  When free user frames drop below WM_LOW,
+ * the kswapd thread wakes and evicts until WM_HIGH frames are
+ * free, so that faulting threads normally find a free frame and
+ * do not evict themselves.  It prefers cold frames that can be
+ * dropped without a write, and leaves dirty anonymous pages to the
+ * clustered swap-out.  KSWAPD_RUNNING is protected by FRAME_LOCK. */
+#define KSWAPD_CLEAN_SCAN 32    /* Frames searched for a clean victim. */
+static size_t wm_low, wm_high;
+static struct semaphore kswapd_sema;
+static bool kswapd_running;
+
+/* Dirty mmap page flusher.  Every FLUSH_INTERVAL ticks, or sooner
+ * after an msync(MS_ASYNC), the flusher thread writes back every
+ * dirty page of a mapped file and marks it clean, so that updates
+ * reach the disk even if the process runs on, and munmap() or exit
+ * finds little left to write.  It walks the frame table a batch at
+ * a time, writing each batch in order of file and offset. */
+#define FLUSH_INTERVAL (5 * TIMER_FREQ)
+static struct semaphore flush_sema; /* Upped by msync(MS_ASYNC). */
+
+/* Transparent huge pages.  A write fault on an anonymous page of
+ * a VMA whose aligned 2 MB block lies wholly in the zero-filled
+ * part of the VMA, and has no other page yet, gets a 2 MB run of
+ * frames mapped by one page directory entry: the rest of the block
+ * then takes no fault and costs one TLB entry.  Each of its pages
+ * is still an ordinary anonymous page with its own frame.  The MMU
+ * layer splits the mapping into 4 kB entries as soon as one page
+ * is unmapped, as on eviction or madvise(MADV_DONTNEED), and fork()
+ * splits it before sharing the pages copy-on-write.  Only used
+ * while free frames are plentiful; -no-thp turns it off. */
+bool thp_enabled = true;
+
+/* Kernel same-page merging.  The low-priority ksmd thread walks
+ * the frame table, KSM_PAGES_TO_SCAN frames every KSM_SLEEP ticks,
+ * checksumming each frame that holds a single anonymous page.  A
+ * frame whose checksum is the same as on the previous pass is
+ * looked up by it, first among the frames KSM already shares (the
+ * stable table), then among this pass's other unchanged frames
+ * (the unstable table, emptied at the end of each pass).  If one
+ * holds the same bytes, the page is write-protected, compared
+ * again, and mapped read-only to that frame, and its own frame is
+ * freed; a page of zeros is mapped to the zero frame instead.  A
+ * write then breaks the sharing through the copy-on-write path.
+ * Pages with a swap slot are left alone, so that all pages of a
+ * shared frame agree on theirs.  Protected by FRAME_LOCK. */
+#define KSM_SLEEP (TIMER_FREQ / 10)
+size_t ksm_pages_to_scan = 64;
+static struct hash ksm_stable;  /* Frames shared by KSM, by checksum. */
+static struct hash ksm_unstable; /* Candidates seen this pass. */
+static size_t ksm_hand;         /* Next frame to scan. */
+static uint32_t ksm_zero_sum;   /* Checksum of a page of zeros. */
+static long long ksm_scan_cnt;  /* Full passes over the frame table. */
+static long long ksm_merge_cnt; /* Pages merged, each freeing a frame. */
+static long long ksm_zero_cnt;  /* ...of which into the zero frame. */
+static long long ksm_unmerge_cnt; /* Merged pages copied on write. */
+
+/* Resident-set limits.  Each process counts the frames its pages
+ * hold as its RSS, a frame shared by several pages once for each
+ * and the zero frame not at all.  A process at its hard limit
+ * evicts one of its own pages to bring in another, and never gets
+ * frames speculatively; the clock takes the frames of processes
+ * over their soft limit first.  Protected by FRAME_LOCK. */
+#define RSS_HARD_MIN 16         /* Smallest hard limit, in pages. */
+static struct list rss_list;    /* Processes with resident pages. */
+static size_t rss_over_cnt;     /* ...of which over their soft limit. */
+
+/* Thrash control.  If more frames than half the frame table were
+ * evicted in the last THRASH_WINDOW ticks, the process with the
+ * largest RSS is held back for THRASH_PAUSE ticks, at its next
+ * page fault from user mode, so that the others can run in the
+ * frames it stops touching.  Protected by FRAME_LOCK. */
+#define THRASH_WINDOW TIMER_FREQ
+#define THRASH_PAUSE (TIMER_FREQ / 2)
+static int64_t thrash_start;    /* Start of the current window. */
+static long long thrash_base;   /* RECLAIM_CNT at THRASH_START. */
+
+/* Reclaim statistics, protected by FRAME_LOCK. */
+static long long scan_cnt;      /* Frames looked at by the clock. */
+static long long reclaim_cnt;   /* Frames evicted. */
+static long long kswapd_cnt;    /* ...of which by kswapd. */
+static long long write_cnt;     /* Pages saved to swap or a file. */
+static long long flush_cnt;     /* Pages written back by msync or flusher. */
+static long long thp_cnt;       /* Huge mappings made. */
+static long long limit_cnt;     /* Frames evicted by their own process. */
+static long long io_wait_cnt;   /* Waits for I/O on a busy frame. */
+static long long thrash_cnt;    /* Processes held back by thrash control. */
+
+static void kswapd(void *aux);
+static void flusher(void *aux);
+static void ksmd(void *aux);
+
+static void frame_table_init(void);
+static hash_hash_func frame_cache_hash;
+static hash_less_func frame_cache_less;
+static hash_hash_func ksm_hash;
+static hash_less_func ksm_less;
+static uint32_t ksm_checksum(const void *kva);
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void vm_init(void)
@@ -20,8 +178,286 @@ void vm_init(void)
 	register_inspect_intr();
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
+	frame_table_init();
+	thread_create("kswapd", PRI_DEFAULT, kswapd, NULL);
+	thread_create("flusher", PRI_DEFAULT, flusher, NULL);
+	if (ksm_pages_to_scan > 0)
+		thread_create("ksmd", PRI_MIN, ksmd, NULL);
+}
+
+/* Allocates the frame table, with one entry per page of the user
+ * pool. */
+static void
+frame_table_init(void)
+{
+	frame_base = palloc_user_pool(&frame_cnt);
+	frame_table = malloc_tagged(frame_cnt * sizeof *frame_table, MT_VM_FRAME);
+	if (frame_table == NULL)
+		PANIC("vm: cannot allocate frame table for %zu frames", frame_cnt);
+	for (size_t i = 0; i < frame_cnt; i++)
+	{
+		frame_table[i] = (struct frame){.kva = frame_base + i * PGSIZE};
+		list_init(&frame_table[i].pages);
+	}
+	hash_init(&frame_cache, frame_cache_hash, frame_cache_less, NULL);
+	zero_frame.kva = palloc_get_page(PAL_ZERO);
+	if (zero_frame.kva == NULL)
+		PANIC("vm: cannot allocate zero page");
+	list_init(&zero_frame.pages);
+	hash_init(&ksm_stable, ksm_hash, ksm_less, NULL);
+	hash_init(&ksm_unstable, ksm_hash, ksm_less, NULL);
+	ksm_zero_sum = ksm_checksum(zero_frame.kva);
+	list_init(&rss_list);
 	lock_init(&frame_lock);
-	list_init(&frame_table);
+	cond_init(&io_done);
+	wm_low = frame_cnt / 64 + SWAP_CLUSTER;
+	wm_high = 2 * wm_low;
+	sema_init(&kswapd_sema, 0);
+	sema_init(&flush_sema, 0);
+}
+
+static uint64_t
+frame_cache_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	const struct frame *f = hash_entry(e, struct frame, cache_elem);
+
+	return hash_bytes(&f->inode, sizeof f->inode) ^ hash_int(f->ofs);
+}
+
+static bool
+frame_cache_less(const struct hash_elem *a_, const struct hash_elem *b_,
+				 void *aux UNUSED)
+{
+	const struct frame *a = hash_entry(a_, struct frame, cache_elem);
+	const struct frame *b = hash_entry(b_, struct frame, cache_elem);
+
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	if (a->ofs != b->ofs)
+		return a->ofs < b->ofs;
+	return a->read_bytes < b->read_bytes;
+}
+
+/* If PAGE, which is not resident, may share a frame through the
+ * page cache, fills in the file block fields of KEY and returns
+ * true. */
+static bool
+frame_cache_key(struct page *page, struct frame *key)
+{
+	if (VM_TYPE(page->operations->type) == VM_UNINIT)
+	{
+		struct lazy_load_arg *arg = page->uninit.aux;
+
+		if (!(page->uninit.type & (VM_FILE_SHARED | VM_FILE_PRIVATE)))
+			return false;
+		key->inode = file_get_inode(arg->file);
+		key->ofs = arg->ofs;
+		key->read_bytes = arg->read_bytes;
+		return true;
+	}
+	if (page->operations->type == VM_FILE
+		&& (page->file.shared || page->file.private))
+	{
+		key->inode = file_get_inode(page->file.file);
+		key->ofs = page->file.file_ofs;
+		key->read_bytes = page->file.read_bytes;
+		return true;
+	}
+	return false;
+}
+
+/* Returns the cached frame holding KEY's file block, or NULL.
+ * FRAME_LOCK must be held. */
+static struct frame *
+frame_cache_find(struct frame *key)
+{
+	struct hash_elem *e;
+
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+
+	e = hash_find(&frame_cache, &key->cache_elem);
+	return e != NULL ? hash_entry(e, struct frame, cache_elem) : NULL;
+}
+
+/* Like frame_cache_find(), but waits out a read of the block that
+ * is in progress, so that the frame returned holds it.  FRAME_LOCK
+ * must be held; it is released while waiting. */
+static struct frame *
+frame_cache_lookup(struct frame *key)
+{
+	struct frame *frame;
+
+	while ((frame = frame_cache_find(key)) != NULL && frame->io)
+	{
+		io_wait_cnt++;
+		cond_wait(&io_done, &frame_lock);
+	}
+	return frame;
+}
+
+/* Enters FRAME, just filled with KEY's file block, in the page
+ * cache, unless another frame got there first.  FRAME_LOCK must
+ * be held. */
+static void
+frame_cache_insert(struct frame *frame, struct frame *key)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	ASSERT(frame->inode == NULL);
+
+	if (frame_cache_find(key) != NULL)
+		return;
+	frame->inode = inode_reopen(key->inode);
+	frame->ofs = key->ofs;
+	frame->read_bytes = key->read_bytes;
+	hash_insert(&frame_cache, &frame->cache_elem);
+}
+
+/* Returns the frame for user pool page KVA. */
+static struct frame *
+kva_to_frame(void *kva)
+{
+	size_t idx = ((uint8_t *)kva - frame_base) / PGSIZE;
+
+	ASSERT(idx < frame_cnt);
+	return &frame_table[idx];
+}
+
+/* Waits until the frame of PAGE, if it has one, is not busy.
+ * FRAME_LOCK must be held; it is released while waiting, so
+ * PAGE->frame may have changed, e.g. to NULL after an eviction,
+ * on return. */
+static void
+page_io_wait(struct page *page)
+{
+	while (page->frame != NULL && page->frame->io)
+	{
+		io_wait_cnt++;
+		cond_wait(&io_done, &frame_lock);
+	}
+}
+
+/* Marks the CNT frames in FRAMES no longer busy, waking whoever
+ * waits for them.  FRAME_LOCK must be held. */
+static void
+frame_io_end(struct frame *frames[], size_t cnt)
+{
+	for (size_t i = 0; i < cnt; i++)
+		frames[i]->io = false;
+	cond_broadcast(&io_done, &frame_lock);
+}
+
+/* Releases the frame table lock, which the caller holds, for I/O,
+ * e.g. on frames it has marked busy.  vm_io_relock() takes it
+ * back. */
+void vm_io_unlock(void)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	lock_release(&frame_lock);
+}
+
+/* Takes back the frame table lock after vm_io_unlock(). */
+void vm_io_relock(void)
+{
+	lock_acquire(&frame_lock);
+}
+
+/* Returns true if T has more resident pages than its soft limit
+ * allows. */
+static bool
+rss_over_soft(const struct thread *t)
+{
+	return t->rss_soft != 0 && t->rss > t->rss_soft;
+}
+
+/* Returns true if T may not have more resident pages. */
+static bool
+rss_at_hard(const struct thread *t)
+{
+	return t->rss_hard != 0 && t->rss >= t->rss_hard;
+}
+
+/* Adds DELTA, 1 or -1, to the RSS of T.  FRAME_LOCK must be
+ * held. */
+static void
+rss_add(struct thread *t, int delta)
+{
+	bool over = rss_over_soft(t);
+
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+
+	if (t->rss == 0)
+		list_push_back(&rss_list, &t->rss_elem);
+	t->rss += delta;
+	if (t->rss == 0)
+		list_remove(&t->rss_elem);
+	if (rss_over_soft(t) != over)
+		rss_over_cnt += over ? -1 : 1;
+}
+
+/* Adds PAGE to the pages held by FRAME.  FRAME_LOCK must be
+ * held. */
+static void
+frame_link(struct frame *frame, struct page *page)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+
+	list_push_back(&frame->pages, &page->rmap_elem);
+	frame->ref_cnt++;
+	page->frame = frame;
+	if (frame != &zero_frame)
+		rss_add(page->owner, 1);
+}
+
+/* Removes PAGE, which must already be unmapped, from the pages
+ * held by FRAME.  FRAME_LOCK must be held. */
+static void
+frame_unlink(struct frame *frame, struct page *page)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	ASSERT(page->frame == frame);
+
+	list_remove(&page->rmap_elem);
+	frame->ref_cnt--;
+	page->frame = NULL;
+	if (frame != &zero_frame)
+		rss_add(page->owner, -1);
+	if (frame->ref_cnt <= 1 && frame->ksm)
+	{
+		/* No longer shared: the last page may write it again. */
+		hash_delete(&ksm_stable, &frame->ksm_elem);
+		frame->ksm = false;
+	}
+	if (frame->ref_cnt == 0 && frame->inode != NULL)
+	{
+		hash_delete(&frame_cache, &frame->cache_elem);
+		inode_close(frame->inode);
+		frame->inode = NULL;
+	}
+}
+
+/* Settles the fault-around accounting of P, a mapped page, given
+ * whether it has been ACCESSED.  FRAME_LOCK must be held. */
+static void
+fa_account(struct page *p, bool accessed)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+
+	if (!p->faulted_around)
+		return;
+	p->faulted_around = false;
+	if (accessed && fa_window < FA_MAX_WINDOW)
+		fa_window++;
+	else if (!accessed && fa_window > 1)
+		fa_window--;
+}
+
+/* Returns the first page held by FRAME, or NULL if it is free. */
+static struct page *
+frame_page(struct frame *frame)
+{
+	if (list_empty(&frame->pages))
+		return NULL;
+	return list_entry(list_front(&frame->pages), struct page, rmap_elem);
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -40,178 +476,1319 @@ page_get_type(struct page *page)
 	}
 }
 
+/* Returns true if PAGE is to be mapped writable now.  A private
+ * file page is not, until it is written. */
+static bool
+page_map_writable(struct page *page)
+{
+	return page->writable && !file_backed_private(page);
+}
+
 /* Helpers */
 static struct frame *vm_get_victim(void);
+static void page_writeback(struct page *page);
 static bool vm_do_claim_page(struct page *page);
 static struct frame *vm_evict_frame(void);
+static void frame_release(struct frame *frame);
+static struct frame *clock_advance(void);
+static bool clock_is_cold(struct frame *f);
+
+/* Create the pending page object with initializer. If you want to create a
+ * page, do not create it directly and make it through this function or
+ * `vm_alloc_page`. */
+bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writable,
+									vm_initializer *init, void *aux)
+{
+	ASSERT(VM_TYPE(type) != VM_UNINIT)
+
+	struct supplemental_page_table *spt = &thread_current()->spt;
+
+	/* Check wheter the upage is already occupied or not. */
+	if (spt_find_page(spt, upage) == NULL)
+	{
+		/* TODO: Create the page, fetch the initialier according to the VM type,
+		 * TODO: and then create "uninit" page struct by calling uninit_new. You
+		 * TODO: should modify the field after calling the uninit_new. */
+		struct page *new_page = (struct page *)malloc_tagged(sizeof(struct page), MT_VM_PAGE);
+
+		// 초기화 함수 세팅 - anon, file-backed에 따라 다르게 설정하기
+		/* enum vm_type type, void *upage, bool writable,
+				vm_initializer *init, void *aux */
+		if (VM_TYPE(type) == VM_ANON) {
+			uninit_new(new_page, pg_round_down(upage), init, type, aux, anon_initializer);
+		}
+		else if (VM_TYPE(type) == VM_FILE) {
+			uninit_new(new_page, pg_round_down(upage), init, type, aux, file_backed_initializer);
+		}
+		/* 지워도 되는 주석 */
+		else {
+			uninit_new(new_page, pg_round_down(upage), init, type, aux, NULL);
+		}
+		// TODO: should modify the field after calling the uninit_new.
+		new_page->writable = writable;
+		new_page->owner = thread_current();
+		/* TODO: Insert the page into the spt. */
+		return spt_insert_page(spt, new_page);
+	}
+	return false;
+err:
+	return false;
+}
+
+/* The supplemental page table is a radix tree indexed by virtual
+ * page number, like the hardware page table but with 128-way nodes:
+ * user addresses lie below KERN_BASE, so their page numbers have
+ * SPT_LEVELS * SPT_BITS = 28 bits.  An interior node's slots point
+ * to nodes of the next level and a leaf's slots to pages.  A node
+ * is 1 kB, a block size malloc() serves without waste, and is
+ * freed once it is empty again.  Lookup allocates nothing, and
+ * walking the tree visits pages in order of address. */
+#define SPT_BITS 7
+#define SPT_FANOUT (1 << SPT_BITS)
+#define SPT_LEVELS 4
+
+struct spt_node {
+	void *slots[SPT_FANOUT];
+};
+
+/* Index in a node of level LEVEL, 0 being the root, of the page
+ * number VPN. */
+static inline size_t
+spt_index(uint64_t vpn, int level)
+{
+	return (vpn >> (SPT_BITS * (SPT_LEVELS - 1 - level))) & (SPT_FANOUT - 1);
+}
+
+static bool
+spt_node_empty(const struct spt_node *node)
+{
+	for (size_t i = 0; i < SPT_FANOUT; i++)
+		if (node->slots[i] != NULL)
+			return false;
+	return true;
+}
+
+/* Find VA from spt and return page. On error, return NULL. */
+struct page *
+spt_find_page(struct supplemental_page_table *spt UNUSED, void *va UNUSED)
+{
+	struct spt_node *node = spt->root;
+	uint64_t vpn = pg_no(va);
+
+	if (!is_user_vaddr(va))
+		return NULL;
+	for (int level = 0; node != NULL && level < SPT_LEVELS - 1; level++)
+		node = node->slots[spt_index(vpn, level)];
+	return node != NULL ? node->slots[spt_index(vpn, SPT_LEVELS - 1)] : NULL;
+}
+
+/* Returns the page of NODE, of level LEVEL, with the lowest page
+ * number at or above *VPN, or NULL if there is none.  On the way
+ * *VPN is advanced past empty subtrees. */
+static struct page *
+spt_next(struct spt_node *node, int level, uint64_t *vpn)
+{
+	int shift = SPT_BITS * (SPT_LEVELS - 1 - level);
+	uint64_t base = *vpn >> (shift + SPT_BITS) << SPT_BITS;
+
+	for (size_t i = spt_index(*vpn, level); i < SPT_FANOUT; i++)
+	{
+		void *slot = node->slots[i];
+
+		if (slot != NULL)
+		{
+			if (level == SPT_LEVELS - 1)
+				return slot;
+			slot = spt_next(slot, level + 1, vpn);
+			if (slot != NULL)
+				return slot;
+		}
+		/* Continue at the start of the next slot. */
+		*vpn = (base + i + 1) << shift;
+	}
+	return NULL;
+}
+
+/* Returns the page of SPT with the lowest address at or above VA,
+ * or NULL if there is none.  Iterating with this visits pages in
+ * order of address, skipping unmapped ranges a node at a time. */
+struct page *
+spt_next_page(struct supplemental_page_table *spt, void *va)
+{
+	uint64_t vpn = pg_no(pg_round_up(va));
+
+	if (spt->root == NULL || !is_user_vaddr(va))
+		return NULL;
+	return spt_next(spt->root, 0, &vpn);
+}
+
+/* Insert PAGE into spt with validation. */
+bool spt_insert_page(struct supplemental_page_table *spt UNUSED,
+					 struct page *page UNUSED)
+{
+	struct spt_node **slot = &spt->root;
+	uint64_t vpn = pg_no(page->va);
+
+	ASSERT(is_user_vaddr(page->va));
+
+	for (int level = 0; level < SPT_LEVELS; level++)
+	{
+		if (*slot == NULL)
+		{
+			*slot = malloc_tagged(sizeof **slot, MT_VM_PAGE);
+			if (*slot == NULL)
+				return false;
+			memset(*slot, 0, sizeof **slot);
+		}
+		slot = (struct spt_node **) &(*slot)->slots[spt_index(vpn, level)];
+	}
+	if (*slot != NULL)
+		return false;
+	*slot = (struct spt_node *) page;
+	return true;
+}
+
+/* Takes PAGE out of SPT's tree, freeing the nodes this empties. */
+static void
+spt_unlink(struct supplemental_page_table *spt, struct page *page)
+{
+	struct spt_node *path[SPT_LEVELS];
+	uint64_t vpn = pg_no(page->va);
+	int level;
+
+	path[0] = spt->root;
+	for (level = 0; level < SPT_LEVELS - 1; level++)
+		path[level + 1] = path[level]->slots[spt_index(vpn, level)];
+	ASSERT(path[SPT_LEVELS - 1]->slots[spt_index(vpn, SPT_LEVELS - 1)] == page);
+
+	for (level = SPT_LEVELS - 1; level >= 0; level--)
+	{
+		path[level]->slots[spt_index(vpn, level)] = NULL;
+		if (!spt_node_empty(path[level]))
+			return;
+		free(path[level]);
+		if (level > 0)
+			path[level - 1]->slots[spt_index(vpn, level - 1)] = NULL;
+	}
+	spt->root = NULL;
+}
+
+/* Removes PAGE from SPT, writing it back and releasing its frame
+ * if it has one, and frees it. */
+void spt_remove_page(struct supplemental_page_table *spt, struct page *page)
+{
+	spt_unlink(spt, page);
+
+	lock_acquire(&frame_lock);
+	page_writeback(page);
+	destroy(page);
+	if (page->frame != NULL)
+	{
+		struct frame *frame = page->frame;
+
+		fa_account(page, pml4_is_accessed(page->owner->pml4, page->va));
+		pml4_clear_page(page->owner->pml4, page->va);
+		frame_unlink(frame, page);
+		if (frame->ref_cnt == 0 && frame != &zero_frame)
+			frame_release(frame);
+	}
+	lock_release(&frame_lock);
+	free(page);
+}
+
+/* Marks FRAME unused and returns its page to the user pool.  The
+ * pages it held must be unmapped and unlinked already.
+ * FRAME_LOCK must be held. */
+static void
+frame_release(struct frame *frame)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	ASSERT(list_empty(&frame->pages));
+	ASSERT(!frame->ksm);
+
+	frame->pin_cnt = 0;
+	palloc_free_page(frame->kva);
+}
+
+/* Releases FRAME, whose pages have been unmapped and unlinked and
+ * whose TLB entries have been flushed. */
+void vm_free_frame(struct frame *frame)
+{
+	lock_acquire(&frame_lock);
+	frame_release(frame);
+	lock_release(&frame_lock);
+}
+
+/* Get the struct frame, that will be evicted.
+ * This is the clock algorithm: the hand keeps its position between
+ * calls, and a frame whose page was accessed since the hand last
+ * passed gets its accessed bit cleared instead of being chosen.
+ * Accessed bits are read from the page tables of the pages' owners.
+ * Two sweeps always find a victim unless every frame is pinned,
+ * in which case this returns NULL.  While some process is over
+ * its soft RSS limit, the sweeps first look only at frames of such
+ * processes.  FRAME_LOCK must be held. */
+static struct frame *
+vm_get_victim(void)
+{
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+
+	if (rss_over_cnt > 0)
+		for (size_t n = 0; n < 2 * frame_cnt; n++)
+		{
+			struct frame *f = clock_advance();
+			if (f->ref_cnt > 0 && rss_over_soft(frame_page(f)->owner)
+				&& clock_is_cold(f))
+				return f;
+		}
+	for (size_t n = 0; n < 2 * frame_cnt; n++)
+	{
+		struct frame *f = clock_advance();
+		if (clock_is_cold(f))
+			return f;
+	}
+	return NULL;
+}
+
+/* Returns the frame under the clock hand and moves the hand on. */
+static struct frame *
+clock_advance(void)
+{
+	struct frame *f = &frame_table[clock_hand];
+
+	clock_hand = clock_hand + 1 < frame_cnt ? clock_hand + 1 : 0;
+	scan_cnt++;
+	return f;
+}
+
+/* Returns true if F may be evicted now: it holds unpinned pages
+ * none of which was accessed since the hand last passed.
+ * Otherwise the pages' accessed bits are cleared, giving them a
+ * second chance. */
+static bool
+clock_is_cold(struct frame *f)
+{
+	struct list_elem *e;
+	bool accessed = false;
+
+	if (f->ref_cnt == 0 || f->pin_cnt > 0)
+		return false;
+	for (e = list_begin(&f->pages); e != list_end(&f->pages); e = list_next(e))
+	{
+		struct page *p = list_entry(e, struct page, rmap_elem);
+		bool a = pml4_is_accessed(p->owner->pml4, p->va);
+
+		fa_account(p, a);
+		if (a)
+		{
+			pml4_set_accessed(p->owner->pml4, p->va, false);
+			accessed = true;
+		}
+	}
+	return !accessed;
+}
+
+/* Returns true if F holds a single anonymous page that has no
+ * up-to-date copy in swap, i.e. one that may join a swap-out
+ * cluster. */
+static bool
+clusterable(struct frame *f)
+{
+	struct page *page = frame_page(f);
+
+	return f->ref_cnt == 1 && page_get_type(page) == VM_ANON
+		&& !anon_has_swap_copy(page);
+}
+
+/* Fills CLUSTER with VICTIM, an anonymous page's frame, and up to
+ * SWAP_CLUSTER - 1 more cold anonymous frames found by sweeping on
+ * for at most 2 * SWAP_CLUSTER frames.  Returns the count. */
+static size_t
+vm_gather_cluster(struct frame *victim, struct frame *cluster[])
+{
+	size_t cnt = 0;
+
+	cluster[cnt++] = victim;
+	for (size_t n = 0; n < 2 * SWAP_CLUSTER && cnt < SWAP_CLUSTER; n++)
+	{
+		struct frame *f = clock_advance();
+		if (f != victim && clock_is_cold(f) && clusterable(f))
+			cluster[cnt++] = f;
+	}
+	return cnt;
+}
+
+/* Evicts VICTIM, a frame shared by several pages: it is unmapped
+ * from all of them.  A page cache frame is then just dropped; an
+ * anonymous frame shared copy-on-write is written once, to a swap
+ * slot they all refer to.  Returns false, leaving it mapped, if
+ * swap is full.  FRAME_LOCK must be held. */
+static bool
+vm_evict_shared(struct frame *victim)
+{
+	struct list_elem *e;
+
+	for (e = list_begin(&victim->pages); e != list_end(&victim->pages); e = list_next(e))
+	{
+		struct page *p = list_entry(e, struct page, rmap_elem);
+		pml4_clear_page(p->owner->pml4, p->va);
+	}
+
+	if (victim->inode == NULL && !anon_swap_out_shared(victim))
+	{
+		for (e = list_begin(&victim->pages); e != list_end(&victim->pages); e = list_next(e))
+		{
+			struct page *p = list_entry(e, struct page, rmap_elem);
+			pml4_set_page(p->owner->pml4, p->va, victim->kva, false);
+		}
+		return false;
+	}
+
+	while (!list_empty(&victim->pages))
+		frame_unlink(victim, frame_page(victim));
+	return true;
+}
+
+/* Returns true if F's contents can be dropped without a write:
+ * it is in the page cache, or holds a clean file page or an
+ * anonymous page with an up-to-date swap copy.  Only a hint while
+ * F is still mapped. */
+static bool
+frame_is_clean(struct frame *f)
+{
+	struct page *page = frame_page(f);
+
+	if (f->inode != NULL)
+		return true;
+	if (f->ref_cnt != 1)
+		return false;
+	if (page_get_type(page) == VM_FILE)
+		return !pml4_is_dirty(page->owner->pml4, page->va);
+	return page_get_type(page) == VM_ANON && anon_has_swap_copy(page);
+}
+
+/* Evicts VICTIM, leaving it unlinked but allocated.  Returns false
+ * if it could not be evicted.  FRAME_LOCK must be held; it is
+ * released during the writes, with the frames being written out
+ * pinned and busy.
+ * An anonymous victim is swapped out together with other cold
+ * anonymous pages, in one contiguous run of swap slots; the extra
+ * frames go back to the user pool, so the next few faults need
+ * not evict. */
+static bool
+vm_evict(struct frame *victim)
+{
+	struct frame *cluster[SWAP_CLUSTER];
+	struct page *pages[SWAP_CLUSTER];
+	bool dirty[SWAP_CLUSTER];
+	size_t cnt = 1, done = 0;
+
+	if (victim->ref_cnt > 1)
+	{
+		bool clean = frame_is_clean(victim), ok;
+
+		victim->pin_cnt++;
+		victim->io = true;
+		ok = vm_evict_shared(victim);
+		victim->pin_cnt--;
+		frame_io_end(&victim, 1);
+		if (!ok)
+			return false;
+		reclaim_cnt++;
+		write_cnt += !clean;
+		return true;
+	}
+	cluster[0] = victim;
+	if (clusterable(victim))
+		cnt = vm_gather_cluster(victim, cluster);
+
+	/* Unmap first, so that the owners cannot change the pages
+	 * while they are being written out.  The dirty bit survives. */
+	for (size_t i = 0; i < cnt; i++)
+	{
+		pages[i] = frame_page(cluster[i]);
+		pml4_clear_page(pages[i]->owner->pml4, pages[i]->va);
+		dirty[i] = !frame_is_clean(cluster[i]);
+		cluster[i]->pin_cnt++;
+		cluster[i]->io = true;
+	}
+
+	/* Settle for shorter runs if swap is fragmented. */
+	for (size_t n = cnt; n > 1 && done == 0; n /= 2)
+		if (anon_swap_out_cluster(pages, n))
+			done = n;
+	if (done == 0 && swap_out(pages[0]))
+		done = 1;
+
+	/* Map back whatever was not written. */
+	for (size_t i = done; i < cnt; i++)
+		pml4_set_page(pages[i]->owner->pml4, pages[i]->va,
+					  cluster[i]->kva, page_map_writable(pages[i]));
+
+	for (size_t i = 0; i < cnt; i++)
+		cluster[i]->pin_cnt--;
+	frame_io_end(cluster, cnt);
+	for (size_t i = 0; i < done; i++)
+	{
+		write_cnt += dirty[i];
+		frame_unlink(cluster[i], pages[i]);
+		if (i > 0)
+			frame_release(cluster[i]);
+	}
+	reclaim_cnt += done;
+	return done > 0;
+}
+
+/* Evicts a cold frame that holds only a page of T, which is at its
+ * hard RSS limit, and returns it, or returns NULL if there is none.
+ * FRAME_LOCK must be held. */
+static struct frame *
+vm_evict_own(struct thread *t)
+{
+	for (size_t n = 0; n < 2 * frame_cnt; n++)
+	{
+		struct frame *f = clock_advance();
+		if (f->ref_cnt == 1 && frame_page(f)->owner == t && clock_is_cold(f))
+		{
+			if (!vm_evict(f))
+				return NULL;
+			limit_cnt++;
+			return f;
+		}
+	}
+	return NULL;
+}
+
+/* Ends the current thrash control window if it is over, holding
+ * back the largest process if there was thrashing in it.
+ * FRAME_LOCK must be held. */
+static void
+thrash_check(void)
+{
+	struct thread *largest = NULL;
+	struct list_elem *e;
+	bool thrashing;
+
+	if (timer_elapsed(thrash_start) < THRASH_WINDOW)
+		return;
+	thrashing = reclaim_cnt - thrash_base > (long long)frame_cnt / 2;
+	thrash_start = timer_ticks();
+	thrash_base = reclaim_cnt;
+	/* Holding back the only process would help no one. */
+	if (!thrashing || list_size(&rss_list) < 2)
+		return;
+	for (e = list_begin(&rss_list); e != list_end(&rss_list); e = list_next(e))
+	{
+		struct thread *t = list_entry(e, struct thread, rss_elem);
+		if (largest == NULL || t->rss > largest->rss)
+			largest = t;
+	}
+	largest->thrash_until = thrash_start + THRASH_PAUSE;
+	thrash_cnt++;
+}
+
+/* Evict one page and return the corresponding frame.
+ * Return NULL on error.  FRAME_LOCK must be held. */
+static struct frame *
+vm_evict_frame(void)
+{
+	struct frame *victim = vm_get_victim();
+
+	if (victim == NULL || !vm_evict(victim))
+		return NULL;
+	return victim;
+}
+
+/* Wakes kswapd if free frames have run low.  FRAME_LOCK must be
+ * held. */
+static void
+kswapd_check(void)
+{
+	if (!kswapd_running && palloc_user_free_cnt() < wm_low)
+	{
+		kswapd_running = true;
+		sema_up(&kswapd_sema);
+	}
+}
+
+/* Frees some frames for kswapd: a cold frame that can be dropped
+ * without a write, if the clock finds one soon, or else the next
+ * victim, with its cluster.  Returns false if nothing could be
+ * freed.  FRAME_LOCK must be held. */
+static bool
+kswapd_reclaim(void)
+{
+	struct frame *victim = NULL;
+	long long before = reclaim_cnt;
+
+	for (size_t n = 0; n < KSWAPD_CLEAN_SCAN && victim == NULL; n++)
+	{
+		struct frame *f = clock_advance();
+		if (clock_is_cold(f) && frame_is_clean(f))
+			victim = f;
+	}
+	if (victim == NULL)
+		victim = vm_get_victim();
+	if (victim == NULL || !vm_evict(victim))
+		return false;
+	frame_release(victim);
+	kswapd_cnt += reclaim_cnt - before;
+	return true;
+}
+
+/* The page-out daemon.  Sleeps until kswapd_check() wakes it, then
+ * reclaims up to the high watermark, dropping FRAME_LOCK between
+ * evictions so that faulting threads are not held up. */
+static void
+kswapd(void *aux UNUSED)
+{
+	for (;;)
+	{
+		bool progress = true;
+
+		sema_down(&kswapd_sema);
+		while (progress && palloc_user_free_cnt() < wm_high)
+		{
+			lock_acquire(&frame_lock);
+			progress = kswapd_reclaim();
+			lock_release(&frame_lock);
+		}
+		lock_acquire(&frame_lock);
+		kswapd_running = false;
+		lock_release(&frame_lock);
+	}
+}
+
+/* Adds P, a dirty page of a mapped file, to the CNT pages in
+ * BATCH, keeping them sorted by file and offset. */
+static void
+flush_add(struct page *batch[], size_t cnt, struct page *p)
+{
+	struct inode *inode = file_get_inode(p->file.file);
+	size_t i = cnt;
+
+	for (; i > 0; i--)
+	{
+		struct page *q = batch[i - 1];
+		struct inode *q_inode = file_get_inode(q->file.file);
+
+		if (q_inode < inode
+			|| (q_inode == inode && q->file.file_ofs < p->file.file_ofs))
+			break;
+		batch[i] = q;
+	}
+	batch[i] = p;
+}
+
+/* Writes back the CNT dirty pages of mapped files in BATCH, in
+ * the order given.  Their frames are pinned and busy meanwhile,
+ * and FRAME_LOCK, which must be held, is dropped for the writes. */
+static void
+flush_batch(struct page *batch[], size_t cnt)
+{
+	struct frame *frames[FILE_WB_MAX];
+
+	if (cnt == 0)
+		return;
+	for (size_t i = 0; i < cnt; i++)
+	{
+		frames[i] = batch[i]->frame;
+		frames[i]->pin_cnt++;
+		frames[i]->io = true;
+	}
+	lock_release(&frame_lock);
+	file_backed_writeback(batch, cnt);
+	lock_acquire(&frame_lock);
+	for (size_t i = 0; i < cnt; i++)
+		frames[i]->pin_cnt--;
+	frame_io_end(frames, cnt);
+	flush_cnt += cnt;
+}
+
+/* Waits for I/O in flight on the frame of PAGE, then writes PAGE
+ * back if it is a dirty page of a mapped file, as flush_batch()
+ * does, so that destroying it afterward needs no I/O under
+ * FRAME_LOCK, which must be held. */
+static void
+page_writeback(struct page *page)
+{
+	page_io_wait(page);
+	if (file_backed_dirty(page))
+		flush_batch(&page, 1);
+}
+
+/* Writes back PAGE like page_writeback() and unmaps it, gathering
+ * the TLB invalidation in TLB. */
+void
+vm_unmap_gather(struct tlb_gather *tlb, struct page *page)
+{
+	lock_acquire(&frame_lock);
+	page_writeback(page);
+	pml4_clear_page_gather(tlb, page->va);
+	lock_release(&frame_lock);
+}
+
+/* Writes back every dirty page of a mapped file, FILE_WB_MAX at a
+ * time.  Each batch is collected under FRAME_LOCK and written with
+ * it dropped. */
+static void
+flush_all(void)
+{
+	struct page *batch[FILE_WB_MAX];
+	size_t i = 0;
+
+	while (i < frame_cnt)
+	{
+		size_t cnt = 0;
+
+		lock_acquire(&frame_lock);
+		for (; i < frame_cnt && cnt < FILE_WB_MAX; i++)
+		{
+			struct frame *f = &frame_table[i];
+			struct page *p = frame_page(f);
+
+			if (p != NULL && f->pin_cnt == 0 && file_backed_dirty(p))
+				flush_add(batch, cnt++, p);
+		}
+		flush_batch(batch, cnt);
+		lock_release(&frame_lock);
+	}
+}
+
+/* The flusher thread. */
+static void
+flusher(void *aux UNUSED)
+{
+	for (;;)
+	{
+		/* One pass serves every msync() made before it starts. */
+		sema_down_timeout(&flush_sema, FLUSH_INTERVAL);
+		while (sema_try_down(&flush_sema))
+			;
+		flush_all();
+	}
+}
+
+static uint64_t
+ksm_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	return hash_int(hash_entry(e, struct frame, ksm_elem)->ksm_sum);
+}
+
+static bool
+ksm_less(const struct hash_elem *a, const struct hash_elem *b,
+		 void *aux UNUSED)
+{
+	return hash_entry(a, struct frame, ksm_elem)->ksm_sum
+		   < hash_entry(b, struct frame, ksm_elem)->ksm_sum;
+}
+
+/* Returns a checksum of the page at KVA: FNV-1a over its 64-bit
+ * words, folded to 32 bits. */
+static uint32_t
+ksm_checksum(const void *kva)
+{
+	const uint64_t *w = kva;
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	for (size_t i = 0; i < PGSIZE / sizeof *w; i++)
+		h = (h ^ w[i]) * 0x100000001b3ULL;
+	return h ^ (h >> 32);
+}
+
+/* Returns true if F holds a single anonymous page that KSM may
+ * merge.  FRAME_LOCK must be held. */
+static bool
+ksm_candidate(struct frame *f)
+{
+	return f->ref_cnt == 1 && f->pin_cnt == 0 && f->inode == NULL && !f->ksm
+		&& anon_mergeable(frame_page(f));
+}
+
+/* Write-protects P, which is mapped, so that its contents cannot
+ * change while they are compared.  Returns false if a huge mapping
+ * covering P could not be split. */
+static bool
+ksm_protect(struct page *p)
+{
+	if (!pml4_split_huge_page(p->owner->pml4, p->va))
+		return false;
+	pml4_set_writable(p->owner->pml4, p->va, false);
+	return true;
+}
+
+/* Maps P, whose frame was found to hold the same bytes as frame T
+ * and has been write-protected, to T instead, read-only, and frees
+ * P's frame.  Returns false, giving P back its own frame, if the
+ * contents differ now.  FRAME_LOCK must be held. */
+static bool
+ksm_merge(struct page *p, struct frame *t)
+{
+	struct frame *f = p->frame;
+	uint64_t *pml4 = p->owner->pml4;
+
+	if (memcmp(f->kva, t->kva, PGSIZE) != 0)
+	{
+		pml4_set_writable(pml4, p->va, page_map_writable(p));
+		return false;
+	}
+	/* The page table stays, so mapping again cannot fail. */
+	pml4_clear_page(pml4, p->va);
+	frame_unlink(f, p);
+	frame_link(t, p);
+	if (!pml4_set_page(pml4, p->va, t->kva, false))
+		PANIC("ksm: cannot remap page");
+	frame_release(f);
+	ksm_merge_cnt++;
+	return true;
+}
+
+/* Looks at F, the next frame of KSM's pass, and merges its page
+ * with an identical one if it can.  FRAME_LOCK must be held. */
+static void
+ksm_scan_frame(struct frame *f)
+{
+	struct page *p, *q;
+	struct hash_elem *e;
+	struct frame *t;
+	uint32_t sum;
+
+	if (!ksm_candidate(f))
+		return;
+	p = frame_page(f);
+
+	/* A page that changed since the last pass probably changes
+	 * often; merging it would only cost a copy-on-write fault. */
+	sum = ksm_checksum(f->kva);
+	if (sum != f->ksm_sum)
+	{
+		f->ksm_sum = sum;
+		return;
+	}
+
+	if (sum == ksm_zero_sum
+		&& memcmp(f->kva, zero_frame.kva, PGSIZE) == 0)
+	{
+		if (ksm_protect(p) && ksm_merge(p, &zero_frame))
+			ksm_zero_cnt++;
+		return;
+	}
+
+	e = hash_find(&ksm_stable, &f->ksm_elem);
+	if (e != NULL)
+	{
+		t = hash_entry(e, struct frame, ksm_elem);
+		if (t->pin_cnt == 0 && memcmp(f->kva, t->kva, PGSIZE) == 0 && ksm_protect(p))
+			ksm_merge(p, t);
+		return;
+	}
+
+	/* Entries of the unstable table may be stale: the frame may
+	 * have changed, or been freed and reused, since. */
+	e = hash_find(&ksm_unstable, &f->ksm_elem);
+	t = e != NULL ? hash_entry(e, struct frame, ksm_elem) : NULL;
+	if (t == NULL || !ksm_candidate(t) || memcmp(f->kva, t->kva, PGSIZE) != 0)
+	{
+		hash_replace(&ksm_unstable, &f->ksm_elem);
+		return;
+	}
+	q = frame_page(t);
+	if (!ksm_protect(q))
+		return;
+	if (!ksm_protect(p))
+	{
+		pml4_set_writable(q->owner->pml4, q->va, page_map_writable(q));
+		return;
+	}
+	hash_delete(&ksm_unstable, &t->ksm_elem);
+	if (!ksm_merge(p, t))
+	{
+		pml4_set_writable(q->owner->pml4, q->va, page_map_writable(q));
+		return;
+	}
+	/* A different page with the same checksum may be stable
+	 * already; T is then shared like a fork()ed frame. */
+	t->ksm = hash_insert(&ksm_stable, &t->ksm_elem) == NULL;
+}
+
+/* The KSM daemon. */
+static void
+ksmd(void *aux UNUSED)
+{
+	for (;;)
+	{
+		timer_sleep(KSM_SLEEP);
+		for (size_t n = 0; n < ksm_pages_to_scan; n++)
+		{
+			lock_acquire(&frame_lock);
+			ksm_scan_frame(&frame_table[ksm_hand]);
+			if (++ksm_hand == frame_cnt)
+			{
+				ksm_hand = 0;
+				hash_clear(&ksm_unstable, NULL);
+				ksm_scan_cnt++;
+			}
+			lock_release(&frame_lock);
+		}
+	}
+}
+
+/* Prints same-page merging statistics. */
+static void
+ksm_print_stats(void)
+{
+	struct hash_iterator i;
+	size_t sharing = 0;
+
+	hash_first(&i, &ksm_stable);
+	while (hash_next(&i))
+		sharing += hash_entry(hash_cur(&i), struct frame, ksm_elem)->ref_cnt;
+	printf("KSM: %lld passes, %lld pages merged (%lld into the zero page), "
+		   "%lld unmerged, %zu pages sharing %zu frames\n",
+		   ksm_scan_cnt, ksm_merge_cnt, ksm_zero_cnt, ksm_unmerge_cnt,
+		   sharing, hash_size(&ksm_stable));
+}
+
+/* Prints reclaim statistics. */
+void vm_print_stats(void)
+{
+	printf("VM: %lld frames scanned, %lld reclaimed (%lld by kswapd), "
+		   "%lld written, %lld flushed, %lld huge\n",
+		   scan_cnt, reclaim_cnt, kswapd_cnt, write_cnt, flush_cnt, thp_cnt);
+	if (io_wait_cnt > 0)
+		printf("VM: %lld waits for in-flight I/O\n", io_wait_cnt);
+	if (limit_cnt > 0 || thrash_cnt > 0)
+		printf("VM: %lld evicted at RSS limits, %lld thrashing pauses\n",
+			   limit_cnt, thrash_cnt);
+	if (ksm_pages_to_scan > 0)
+		ksm_print_stats();
+}
+
+/* palloc() and get frame. If there is no available page, evict the page
+ * and return it.  If the user pool memory is full, this function
+ * evicts the frame to get the available memory space.  Returns NULL
+ * only if nothing could be evicted.  The frame comes back pinned;
+ * the caller unpins it once the page is loaded.  A process at its
+ * hard RSS limit gets one of its own frames back instead. */
+static struct frame *
+vm_get_frame(void)
+{
+	struct thread *t = thread_current();
+	struct frame *frame = NULL;
+	void *kva;
+
+	lock_acquire(&frame_lock);
+	thrash_check();
+	if (rss_at_hard(t))
+		frame = vm_evict_own(t);
+	if (frame != NULL)
+		;
+	else if ((kva = palloc_get_page(PAL_USER)) != NULL)
+		frame = kva_to_frame(kva);
+	else
+		frame = vm_evict_frame();
+	if (frame != NULL)
+	{
+		ASSERT(frame->ref_cnt == 0);
+		frame->pin_cnt++;
+	}
+	kswapd_check();
+	lock_release(&frame_lock);
+	return frame;
+}
+
+/* Returns a frame for PAGE if one is free without evicting
+ * anything, or NULL.  The frame comes back linked to PAGE and
+ * pinned.  Used to fill frames speculatively, e.g. for swap
+ * readahead. */
+struct frame *
+vm_get_free_frame(struct page *page)
+{
+	struct frame *frame = NULL;
+	void *kva;
+
+	lock_acquire(&frame_lock);
+	kva = rss_at_hard(page->owner) ? NULL : palloc_get_page(PAL_USER);
+	if (kva != NULL)
+	{
+		frame = kva_to_frame(kva);
+		frame_link(frame, page);
+		frame->pin_cnt++;
+	}
+	kswapd_check();
+	lock_release(&frame_lock);
+	return frame;
+}
+
+/* Makes FRAME evictable again. */
+void vm_unpin_frame(struct frame *frame)
+{
+	lock_acquire(&frame_lock);
+	frame->pin_cnt--;
+	lock_release(&frame_lock);
+}
+
+/* Growing the stack. */
+static void
+vm_stack_growth(void *addr UNUSED)
+{
+	/* anonymous 페이지를 할당하여 스택 크기를 늘림 */
+	vm_alloc_page_with_initializer (VM_ANON, pg_round_down(addr), 1, NULL, NULL);
+}
+
+/* Handle the fault on write_protected page.
+ * PAGE shares its frame copy-on-write since fork(), or maps the
+ * zero frame: it gets a private copy, unless every other sharer
+ * of a fork()ed frame has gone already, in which case it takes the
+ * frame over and only the write permission is restored.  A page of
+ * a private file mapping becomes anonymous, the same way; it copies
+ * a frame in the page cache, which others may find later. */
+static bool
+vm_handle_wp(struct page *page)
+{
+	struct thread *t = thread_current();
+	struct frame *old, *new;
+	bool private, ok;
+
+	lock_acquire(&frame_lock);
+	page_io_wait(page);
+	old = page->frame;
+	if (old == NULL)
+	{
+		/* Evicted in the meantime; the retried access faults it
+		 * back in. */
+		lock_release(&frame_lock);
+		return true;
+	}
+	private = file_backed_private(page);
+	if (old->ref_cnt == 1 && old != &zero_frame
+		&& (!private || old->inode == NULL))
+	{
+		if (private)
+			anon_initializer(page, VM_ANON, old->kva);
+		pml4_set_writable(t->pml4, page->va, true);
+		lock_release(&frame_lock);
+		return true;
+	}
+	old->pin_cnt++;
+	if (old->ksm)
+		ksm_unmerge_cnt++;
+	lock_release(&frame_lock);
+
+	new = vm_get_frame();
+	if (new == NULL)
+	{
+		vm_unpin_frame(old);
+		return false;
+	}
+	memcpy(new->kva, old->kva, PGSIZE);
+
+	lock_acquire(&frame_lock);
+	old->pin_cnt--;
+	if (page->frame != old)
+	{
+		/* Changed while the lock was dropped; the retried access
+		 * faults again if it still has to. */
+		frame_release(new);
+		lock_release(&frame_lock);
+		return true;
+	}
+	pml4_clear_page(t->pml4, page->va);
+	frame_unlink(old, page);
+	frame_link(new, page);
+	ok = pml4_set_page(t->pml4, page->va, new->kva, true);
+	if (!ok)
+	{
+		frame_unlink(new, page);
+		frame_release(new);
+	}
+	else
+	{
+		if (private)
+			anon_initializer(page, VM_ANON, new->kva);
+		new->pin_cnt--;
+	}
+	lock_release(&frame_lock);
+	return ok;
+}
+
+/* If PAGE, which is not resident, is to be loaded from a file,
+ * stores where from in *SRC and returns true. */
+static bool
+page_file_source(struct page *page, struct lazy_load_arg *src)
+{
+	if (VM_TYPE(page->operations->type) == VM_UNINIT
+		&& page->uninit.init == lazy_load_segment)
+	{
+		*src = *(struct lazy_load_arg *)page->uninit.aux;
+		return true;
+	}
+	if (page->operations->type == VM_FILE)
+	{
+		src->file = page->file.file;
+		src->ofs = page->file.file_ofs;
+		src->read_bytes = page->file.read_bytes;
+		src->zero_bytes = page->file.zero_bytes;
+		return true;
+	}
+	return false;
+}
 
-/* Create the pending page object with initializer. If you want to create a
- * page, do not create it directly and make it through this function or
- * `vm_alloc_page`. */
-bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writable,
-									vm_initializer *init, void *aux)
+/* Fault-around after a read fault on PAGE, which was just loaded
+ * from SRC: loads and maps up to WINDOW pages that follow PAGE and
+ * continue SRC in the same file.  Gives up quietly on anything
+ * unusual; the pages then fault in one by one as before. */
+static void
+vm_fault_around(struct page *page, const struct lazy_load_arg *src,
+				size_t window)
 {
-	ASSERT(VM_TYPE(type) != VM_UNINIT)
+	struct thread *t = thread_current();
+	struct disk_iovec iov[FA_MAX_WINDOW];
+	struct page *pages[FA_MAX_WINDOW];
+	struct lazy_load_arg args[FA_MAX_WINDOW];
+	struct frame keys[FA_MAX_WINDOW];
+	struct lazy_load_arg prev = *src;
+	size_t cnt = 0;
+	bool ok, cached;
 
-	struct supplemental_page_table *spt = &thread_current()->spt;
+	/* Only whole pages lead on to the next block of the file. */
+	while (cnt < window && prev.read_bytes == PGSIZE)
+	{
+		uint8_t *va = (uint8_t *)page->va + (cnt + 1) * PGSIZE;
+		struct lazy_load_arg next;
+		struct page *p;
+		struct frame *frame;
 
-	/* Check wheter the upage is already occupied or not. */
-	if (spt_find_page(spt, upage) == NULL)
+		if (!is_user_vaddr(va))
+			break;
+		p = vma_get_page(&t->spt, va);
+		if (p == NULL || p->frame != NULL || !page_file_source(p, &next)
+			|| file_get_inode(next.file) != file_get_inode(src->file)
+			|| next.ofs != prev.ofs + PGSIZE || next.ofs % DISK_SECTOR_SIZE != 0
+			|| next.read_bytes == 0)
+			break;
+
+		/* A block in the page cache is mapped on its own fault. */
+		lock_acquire(&frame_lock);
+		cached = frame_cache_key(p, &keys[cnt]) && frame_cache_find(&keys[cnt]) != NULL;
+		lock_release(&frame_lock);
+		if (cached || (frame = vm_get_free_frame(p)) == NULL)
+			break;
+		pages[cnt] = p;
+		args[cnt] = next;
+		iov[cnt++] = (struct disk_iovec){
+			.buf = frame->kva,
+			.sec_cnt = DIV_ROUND_UP(next.read_bytes, DISK_SECTOR_SIZE)};
+		prev = next;
+	}
+	if (cnt == 0)
+		return;
+
+	ok = file_readv_at(src->file, iov, cnt, args[0].ofs);
+
+	lock_acquire(&frame_lock);
+	for (size_t i = 0; i < cnt; i++)
 	{
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
-		struct page *new_page = (struct page *)malloc(sizeof(struct page));
+		struct page *p = pages[i];
+		struct frame *frame = p->frame;
 
-		// 초기화 함수 세팅 - anon, file-backed에 따라 다르게 설정하기
-		/* enum vm_type type, void *upage, bool writable,
-				vm_initializer *init, void *aux */
-		if (VM_TYPE(type) == VM_ANON) {
-			uninit_new(new_page, pg_round_down(upage), init, type, aux, anon_initializer);
-		}
-		else if (VM_TYPE(type) == VM_FILE) {
-			uninit_new(new_page, pg_round_down(upage), init, type, aux, file_backed_initializer);
+		if (ok)
+			memset((uint8_t *)frame->kva + args[i].read_bytes, 0,
+				   PGSIZE - args[i].read_bytes);
+		if (ok && pml4_set_page(t->pml4, p->va, frame->kva, page_map_writable(p)))
+		{
+			if (frame_cache_key(p, &keys[i]))
+				frame_cache_insert(frame, &keys[i]);
+			if (VM_TYPE(p->operations->type) == VM_UNINIT)
+				uninit_transmute(p, frame->kva);
+			p->faulted_around = true;
+			frame->pin_cnt--;
 		}
-		/* 지워도 되는 주석 */
-		else {
-			uninit_new(new_page, pg_round_down(upage), init, type, aux, NULL);
+		else
+		{
+			frame_unlink(frame, p);
+			frame_release(frame);
 		}
-		// TODO: should modify the field after calling the uninit_new.
-		new_page->writable = writable;
-		/* TODO: Insert the page into the spt. */
-		return spt_insert_page(spt, new_page);
 	}
-	return false;
-err:
-	return false;
+	lock_release(&frame_lock);
 }
 
-/* Find VA from spt and return page. On error, return NULL. */
-struct page *
-spt_find_page(struct supplemental_page_table *spt UNUSED, void *va UNUSED)
+/* On a read fault on PAGE, an anonymous page that has never been
+ * loaded and would start out all zeros, maps the zero frame there
+ * and returns true.  Otherwise returns false. */
+static bool
+vm_map_zero(struct page *page)
 {
-	struct page *page = NULL;
-	struct hash_elem *e;
-	/* TODO: Fill this function. */
-	page = (struct page *)malloc(sizeof(struct page));
-	/* [수정] va가 속한 페이지의 시작 위치를 리턴 */
-	page->va = pg_round_down(va);
-	e = hash_find(&spt->pages, &page->hash_elem);
-	/* [수정] hash_entry로 struct page 형태로 바꿔줘야 함 */
-	free(page);
-	if (e != NULL) {
-		return hash_entry(e, struct page, hash_elem);
-	}
-	return NULL;
-}
+	struct lazy_load_arg *arg = page->uninit.aux;
+	bool ok;
 
-/* Insert PAGE into spt with validation. */
-bool spt_insert_page(struct supplemental_page_table *spt UNUSED,
-					 struct page *page UNUSED)
-{
-	int succ = false;
-	/* TODO: Fill this function. */
-	struct hash_elem *e = hash_insert(&spt->pages, &page->hash_elem);
-	if (e == NULL) {
-		succ = true;
-	}
-	return succ;
+	if (VM_TYPE(page->operations->type) != VM_UNINIT
+		|| VM_TYPE(page->uninit.type) != VM_ANON)
+		return false;
+	if (page->uninit.init != NULL
+		&& (page->uninit.init != lazy_load_segment || arg->read_bytes != 0))
+		return false;
+
+	lock_acquire(&frame_lock);
+	frame_link(&zero_frame, page);
+	ok = pml4_set_page(page->owner->pml4, page->va, zero_frame.kva, false);
+	if (ok)
+		uninit_transmute(page, zero_frame.kva);
+	else
+		frame_unlink(&zero_frame, page);
+	lock_release(&frame_lock);
+	return ok;
 }
 
-void spt_remove_page(struct supplemental_page_table *spt, struct page *page)
+/* Removes the pages that vm_map_huge() made for the block at BASE
+ * below END, leaving PAGE, the faulting one. */
+static void
+vm_huge_undo(struct page *page, uint8_t *base, uint8_t *end)
 {
-	hash_delete(&spt->pages, &page->hash_elem);
-	vm_dealloc_page(page);
+	struct supplemental_page_table *spt = &page->owner->spt;
+
+	for (uint8_t *va = base; va < end; va += PGSIZE)
+		if (va != page->va)
+			spt_remove_page(spt, spt_find_page(spt, va));
 }
 
-/* Get the struct frame, that will be evicted. */
-static struct frame *
-vm_get_victim(void)
+/* On a write fault on PAGE, an anonymous page that has never been
+ * loaded, backs PAGE's whole 2 MB block with a huge page if it
+ * qualifies, and returns true.  Otherwise returns false, and PAGE
+ * is faulted in alone as usual. */
+static bool
+vm_map_huge(struct page *page)
 {
-	struct frame *victim = NULL;
-	/* TODO: The policy for eviction is up to you. */
-	struct thread *curr = thread_current();
+	struct thread *t = page->owner;
+	struct supplemental_page_table *spt = &t->spt;
+	struct vma *vma = vma_find(spt, page->va);
+	uint8_t *base = hpg_round_down(page->va), *end = base + HPGSIZE;
+	uint8_t *kva, *va;
+	struct page *p;
+	bool ok;
 
-	lock_acquire(&frame_lock);
-	struct list_elem *start = list_begin(&frame_table);
-	for (start; start != list_end(&frame_table); start = list_next(start))
-	{
-		victim = list_entry(start, struct frame, frame_elem);
-		if (victim->page == NULL) // frame에 할당된 페이지가 없는 경우 (page가 destroy된 경우 )
+	if (!thp_enabled || vma == NULL || VM_TYPE(vma->type) != VM_ANON
+		|| !vma->writable || VM_TYPE(page->operations->type) != VM_UNINIT
+		|| base < (uint8_t *)vma->start || end > (uint8_t *)vma->end
+		|| (size_t)(base - (uint8_t *)vma->start) < vma->read_bytes)
+		return false;
+	p = spt_next_page(spt, page->va + PGSIZE);
+	if (spt_next_page(spt, base) != page || (p != NULL && (uint8_t *)p->va < end))
+		return false;
+	if (palloc_user_free_cnt() < PGS_PER_HPG + wm_high)
+		return false;
+	if ((t->rss_soft != 0 && t->rss + PGS_PER_HPG > t->rss_soft)
+		|| (t->rss_hard != 0 && t->rss + PGS_PER_HPG > t->rss_hard))
+		return false;
+	kva = palloc_get_multiple_aligned(PAL_USER | PAL_ZERO, PGS_PER_HPG,
+									  PGS_PER_HPG);
+	if (kva == NULL)
+		return false;
+
+	for (va = base; va < end; va += PGSIZE)
+		if (va != page->va && !vm_alloc_page(VM_ANON, va, true))
 		{
-			lock_release(&frame_lock);
-			return victim;
+			vm_huge_undo(page, base, va);
+			palloc_free_multiple(kva, PGS_PER_HPG);
+			return false;
 		}
-		if (pml4_is_accessed(curr->pml4, victim->page->va))
-			pml4_set_accessed(curr->pml4, victim->page->va, 0);
-		else
+
+	/* The frames are not linked yet, so the clock cannot pick one
+	 * before they all are. */
+	lock_acquire(&frame_lock);
+	ok = pml4_set_huge_page(page->owner->pml4, base, kva, true);
+	if (ok)
+	{
+		for (va = base; va < end; va += PGSIZE)
 		{
-			lock_release(&frame_lock);
-			return victim;
+			p = spt_find_page(spt, va);
+			frame_link(kva_to_frame(kva + (va - base)), p);
+			uninit_transmute(p, p->frame->kva);
 		}
+		thp_cnt++;
 	}
+	kswapd_check();
 	lock_release(&frame_lock);
-	return victim;
+	if (!ok)
+	{
+		vm_huge_undo(page, base, end);
+		palloc_free_multiple(kva, PGS_PER_HPG);
+	}
+	return ok;
 }
 
-/* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
-static struct frame *
-vm_evict_frame(void)
+/* Drop-behind for MADV_SEQUENTIAL.  After a fault on PAGE, of
+ * VMA, the pages more than FA_MAX_WINDOW pages behind it will not
+ * be read again soon, so their accessed bits are cleared: the clock
+ * then takes them first, and kswapd drops the clean ones without
+ * I/O. */
+static void
+vm_drop_behind(struct page *page, struct vma *vma)
 {
-	struct frame *victim UNUSED = vm_get_victim();
-	/* TODO: swap out the victim and return the evicted frame. */
-	if (swap_out(victim->page))
-	{
-		return victim;
-	}
-	return NULL;
+	struct supplemental_page_table *spt = &page->owner->spt;
+	uint8_t *start = vma->start, *end = page->va;
+	struct page *p;
+
+	if (end - start <= FA_MAX_WINDOW * PGSIZE)
+		return;
+	end -= FA_MAX_WINDOW * PGSIZE;
+	if (end - start > FA_MAX_WINDOW * PGSIZE)
+		start = end - FA_MAX_WINDOW * PGSIZE;
+
+	lock_acquire(&frame_lock);
+	for (p = spt_next_page(spt, start); p != NULL && (uint8_t *)p->va < end;
+		 p = spt_next_page(spt, p->va + PGSIZE))
+		if (p->frame != NULL && !p->faulted_around)
+			pml4_set_accessed(p->owner->pml4, p->va, false);
+	lock_release(&frame_lock);
 }
 
-/* palloc() and get frame. If there is no available page, evict the page
- * and return it. This always return valid address. That is, if the user pool
- * memory is full, this function evicts the frame to get the available memory
- * space.*/
-static struct frame *
-vm_get_frame(void)
+/* Brings in PAGE, which is not present, after a fault on it, a
+ * write fault if WRITE is true, following the madvise() advice of
+ * its VMA.  Also prefaults pages for MADV_WILLNEED. */
+static bool
+vm_fault_in(struct page *page, bool write)
 {
-	struct frame *frame = NULL;
-	frame = malloc(sizeof(struct frame));
+	struct vma *vma = vma_find(&page->owner->spt, page->va);
+	int advice = vma != NULL ? vma->advice : MADV_NORMAL;
+	struct lazy_load_arg src;
+	size_t window;
+	bool around;
 
-	/* TODO: Fill this function. */
-	frame->kva = palloc_get_page(PAL_USER);
-	if (frame->kva == NULL) {
-		/* eviction이 일어나는 시점 */
-		free(frame);
-		struct frame *victim = vm_evict_frame();
-		// victim->page->frame = NULL;
-		victim->page = NULL;
+	if (write ? vm_map_huge(page) : vm_map_zero(page))
+		return true;
 
-		return victim;
-	}
-	frame->page = NULL;
-	/* 새로 만들어준 frame에 대해서만 table에 추가 */
 	lock_acquire(&frame_lock);
-	list_push_back(&frame_table, &frame->frame_elem);
+	window = fa_window;
 	lock_release(&frame_lock);
+	if (advice == MADV_SEQUENTIAL)
+		window = FA_MAX_WINDOW;
+	else if (advice == MADV_RANDOM)
+		window = 0;
 
-	ASSERT(frame != NULL);
-	ASSERT(frame->page == NULL);
-	return frame;
+	around = !write && window > 0 && page_file_source(page, &src);
+	if (!vm_do_claim_page(page))
+		return false;
+	/* Spare the write the fault it would take on the read-only
+	 * mapping. */
+	if (write && file_backed_private(page) && !vm_handle_wp(page))
+		return false;
+	if (around)
+		vm_fault_around(page, &src, window);
+	if (advice == MADV_SEQUENTIAL)
+		vm_drop_behind(page, vma);
+	return true;
 }
 
-/* Growing the stack. */
+/* Holds the current thread back while thrash control has picked
+ * it. */
 static void
-vm_stack_growth(void *addr UNUSED)
+vm_thrash_wait(void)
 {
-	/* anonymous 페이지를 할당하여 스택 크기를 늘림 */
-	vm_alloc_page_with_initializer (VM_ANON, pg_round_down(addr), 1, NULL, NULL);
-}
+	int64_t until = thread_current()->thrash_until;
 
-/* Handle the fault on write_protected page */
-static bool
-vm_handle_wp(struct page *page UNUSED)
-{
+	if (until > timer_ticks())
+		timer_sleep(until - timer_ticks());
 }
 
 /* Return true on success */
@@ -226,20 +1803,33 @@ bool vm_try_handle_fault(struct intr_frame *f UNUSED, void *addr UNUSED,
 	/* TODO: Validate the fault */
 	/* if문으로 not present인지 확인 -> find page*/
 	/* TODO: Your code goes here */
+	/* A fault from user mode holds no kernel locks, so the thread
+	 * may wait here. */
+	if (user)
+		vm_thrash_wait();
+
 	if (not_present) {
 		rsp = (user == true)? f->rsp : thread_current()->user_rsp;
 		if (USER_STACK - USER_STK_LIMIT <= rsp - 8 && rsp - 8 <= addr && addr <= USER_STACK) {
 			vm_stack_growth(addr);
 		}
 		
-		page = spt_find_page(spt, addr);
+		page = vma_get_page(spt, addr);
 		if (page == NULL)
 			return false;
 
 		if (write == 1 && page->writable == 0)
 			return false;
 
-		return vm_do_claim_page(page);
+		return vm_fault_in(page, write);
+	}
+
+	/* Write to a present, read-only page: copy-on-write. */
+	if (write && is_user_vaddr(addr)) {
+		page = spt_find_page(spt, addr);
+		if (page == NULL || !page->writable)
+			return false;
+		return vm_handle_wp(page);
 	}
 	/*이 함수에서는 Page Fault가 스택을 증가시켜야하는 경우에 해당하는지 아닌지를 확인해야 합니다.
 	스택 증가로 Page Fault 예외를 처리할 수 있는지 확인한 경우, 
@@ -264,7 +1854,7 @@ bool vm_claim_page(void *va UNUSED)
 	struct page *page = NULL;
 	/* TODO: Fill this function */
 	/* [수정] spt_find_page로 va에 해당하는 페이지가 있는지 찾음 */
-	page = spt_find_page(&thread_current()->spt, va);
+	page = vma_get_page(&thread_current()->spt, va);
 	if (page == NULL) {
 		return false;
 	}
@@ -272,42 +1862,258 @@ bool vm_claim_page(void *va UNUSED)
 	return vm_do_claim_page(page);
 }
 
-/* Claim the PAGE and set up the mmu. */
-static bool
-vm_do_claim_page(struct page *page)
+/* Applies madvise() ADVICE to the LENGTH bytes at ADDR, which must
+ * be page-aligned, in the current process.
+ *
+ * MADV_NORMAL, MADV_RANDOM and MADV_SEQUENTIAL are recorded in every
+ * VMA the range touches and apply to the whole VMA; the fault path
+ * and swap readahead consult them.  MADV_WILLNEED loads each page
+ * of the range that is not resident before returning: unlike
+ * Linux's, it is synchronous.  The fault path maps what it loads
+ * into the current thread's page table, so no kernel thread can
+ * load pages for the process, and one loading on the side could
+ * race with the process's exit tearing its table down.  File pages
+ * still come in with fault-around, several blocks per transfer.
+ * mmap(MAP_POPULATE), which has to load before returning anyway,
+ * is done this way too.  MADV_DONTNEED frees the range's pages: a
+ * page of a VMA, after writing it back if it maps a file, is made
+ * again from the VMA on its next fault, and any other page, which
+ * is anonymous, comes back zeroed.
+ *
+ * Returns false if the arguments are bad. */
+bool
+do_madvise(void *addr, size_t length, int advice)
 {
-	struct thread *t = thread_current();
-	struct frame *frame = vm_get_frame();
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *start = addr, *end = start + ROUND_UP(length, PGSIZE), *va;
+	struct page *p;
+	struct vma *vma;
 
-	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	if (pg_ofs(addr) != 0 || end < start
+		|| (end > start && !is_user_vaddr(end - 1)))
+		return false;
+
+	switch (advice)
+	{
+	case MADV_NORMAL:
+	case MADV_RANDOM:
+	case MADV_SEQUENTIAL:
+		for (va = start; va < end; va += PGSIZE)
+			if ((vma = vma_find(spt, va)) != NULL)
+			{
+				vma->advice = advice;
+				va = (uint8_t *)vma->end - PGSIZE;
+			}
+		return true;
+
+	case MADV_WILLNEED:
+		for (va = start; va < end; va += PGSIZE)
+		{
+			p = vma_get_page(spt, va);
+			if (p != NULL && p->frame == NULL)
+				vm_fault_in(p, false);
+		}
+		return true;
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
-	pml4_set_page(t->pml4, page->va, frame->kva, page->writable);
+	case MADV_DONTNEED:
+		for (p = spt_next_page(spt, start); p != NULL && (uint8_t *)p->va < end;
+			 p = spt_next_page(spt, va))
+		{
+			bool writable = p->writable;
+			bool anon = vma_find(spt, p->va) == NULL;
+
+			va = (uint8_t *)p->va + PGSIZE;
+			spt_remove_page(spt, p);
+			if (anon && !vm_alloc_page(VM_ANON, va - PGSIZE, writable))
+				return false;
+		}
+		return true;
 
-	return swap_in(page, frame->kva);
+	default:
+		return false;
+	}
 }
 
-unsigned
-supplemental_page_hash (const struct hash_elem *p_, void *aux UNUSED) {
-  const struct page *p = hash_entry (p_, struct page, hash_elem);
-  return hash_bytes (&p->va, sizeof p->va);
+/* Writes back the dirty pages of mapped files in the LENGTH bytes
+ * at ADDR, which must be page-aligned and mapped, in the current
+ * process.  With MS_SYNC the writes are done on return, in order
+ * of address, which is file-offset order within a mapping.  With
+ * MS_ASYNC they are left to the flusher, which is woken now.
+ * The writes are made with FRAME_LOCK dropped, as by the flusher.
+ * Returns false if the arguments are bad. */
+bool
+do_msync(void *addr, size_t length, int flags)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *start = addr, *end = start + ROUND_UP(length, PGSIZE), *va;
+	struct page *batch[FILE_WB_MAX];
+	struct page *p;
+	struct vma *vma;
+	size_t cnt = 0;
+
+	if (pg_ofs(addr) != 0 || end < start
+		|| (end > start && !is_user_vaddr(end - 1))
+		|| (flags != MS_SYNC && flags != MS_ASYNC))
+		return false;
+	for (va = start; va < end; va = vma->end)
+		if ((vma = vma_find(spt, va)) == NULL)
+			return false;
+
+	if (flags == MS_ASYNC)
+	{
+		sema_up(&flush_sema);
+		return true;
+	}
+
+	lock_acquire(&frame_lock);
+	for (p = spt_next_page(spt, start); p != NULL && (uint8_t *)p->va < end;
+		 p = spt_next_page(spt, p->va + PGSIZE))
+	{
+		/* A page being evicted or flushed may have been dirtied
+		 * after its write began; wait for that write, then look
+		 * again.  The wait drops the lock, so write out what is
+		 * gathered first. */
+		if (p->frame != NULL && p->frame->io)
+		{
+			flush_batch(batch, cnt);
+			cnt = 0;
+			page_io_wait(p);
+		}
+		if (!file_backed_dirty(p))
+			continue;
+		batch[cnt++] = p;
+		if (cnt == FILE_WB_MAX)
+		{
+			flush_batch(batch, cnt);
+			cnt = 0;
+		}
+	}
+	flush_batch(batch, cnt);
+	lock_release(&frame_lock);
+	return true;
 }
 
+/* Sets the soft and hard limits on the resident set of the current
+ * process to SOFT and HARD bytes, rounded up to pages, 0 meaning
+ * no limit.  An RSS already above a new limit shrinks as the
+ * process faults.  Returns false if HARD is below RSS_HARD_MIN
+ * pages, which a process may need at once, or SOFT exceeds HARD. */
 bool
-supplemental_page_less (const struct hash_elem *a_,
-           const struct hash_elem *b_, void *aux UNUSED) {
-  const struct page *a = hash_entry (a_, struct page, hash_elem);
-  const struct page *b = hash_entry (b_, struct page, hash_elem);
+do_rsslimit(size_t soft, size_t hard)
+{
+	struct thread *t = thread_current();
+	bool over;
+
+	if (hard != 0 && (hard < RSS_HARD_MIN * PGSIZE || soft > hard))
+		return false;
+
+	lock_acquire(&frame_lock);
+	over = rss_over_soft(t);
+	t->rss_soft = soft / PGSIZE + (soft % PGSIZE != 0);
+	t->rss_hard = hard / PGSIZE + (hard % PGSIZE != 0);
+	if (rss_over_soft(t) != over)
+		rss_over_cnt += over ? -1 : 1;
+	lock_release(&frame_lock);
+	return true;
+}
+
+/* Maps PAGE, which is read-only, to FRAME, found in the page cache
+ * with PAGE's file block.  FRAME_LOCK must be held. */
+static bool
+vm_map_cached(struct page *page, struct frame *frame)
+{
+	frame_link(frame, page);
+	if (!pml4_set_page(page->owner->pml4, page->va, frame->kva, false))
+	{
+		frame_unlink(frame, page);
+		return false;
+	}
+	if (VM_TYPE(page->operations->type) == VM_UNINIT)
+		uninit_transmute(page, frame->kva);
+	return true;
+}
+
+/* Claim the PAGE and set up the mmu. */
+static bool
+vm_do_claim_page(struct page *page)
+{
+	struct thread *t = thread_current();
+	struct frame *frame, *cached, key;
+	bool cacheable, ok;
+
+	/* A page being evicted is waited for: it is then either gone,
+	 * or still there and mapped again if eviction failed.  A page
+	 * in the swap cache already has its frame, and a file block
+	 * may be in the page cache, or on its way there. */
+	lock_acquire(&frame_lock);
+	page_io_wait(page);
+	frame = page->frame;
+	if (frame != NULL && pml4_get_page(t->pml4, page->va) != NULL)
+	{
+		lock_release(&frame_lock);
+		return true;
+	}
+	cacheable = frame == NULL && frame_cache_key(page, &key);
+	if (frame != NULL)
+		frame->pin_cnt++;
+	else if (cacheable && (cached = frame_cache_lookup(&key)) != NULL)
+	{
+		ok = vm_map_cached(page, cached);
+		lock_release(&frame_lock);
+		return ok;
+	}
+	lock_release(&frame_lock);
 
-  return a->va < b->va;
+	if (frame == NULL)
+	{
+		frame = vm_get_frame();
+		if (frame == NULL)
+			return false;
+
+		/* Set links.  Another process may have started reading the
+		 * block meanwhile; otherwise the frame enters the page
+		 * cache now, busy, so that others wait for this read
+		 * instead of making their own. */
+		lock_acquire(&frame_lock);
+		if (cacheable && (cached = frame_cache_lookup(&key)) != NULL)
+		{
+			frame_release(frame);
+			ok = vm_map_cached(page, cached);
+			lock_release(&frame_lock);
+			return ok;
+		}
+		frame_link(frame, page);
+		if (cacheable)
+		{
+			frame_cache_insert(frame, &key);
+			frame->io = true;
+		}
+		lock_release(&frame_lock);
+	}
+
+	/* Load the contents before mapping, so the page is never
+	 * visible half-filled. */
+	ok = swap_in(page, frame->kva)
+		&& pml4_set_page(t->pml4, page->va, frame->kva, page_map_writable(page));
+
+	lock_acquire(&frame_lock);
+	if (!ok)
+		frame_unlink(frame, page);
+	if (frame->io)
+		frame_io_end(&frame, 1);
+	if (!ok)
+		frame_release(frame);
+	else
+		frame->pin_cnt--;
+	lock_release(&frame_lock);
+	return ok;
 }
 
 /* Initialize new supplemental page table */
 void supplemental_page_table_init(struct supplemental_page_table *spt UNUSED)
 {
-	hash_init (&spt->pages, supplemental_page_hash, supplemental_page_less, NULL);
+	spt->root = NULL;
+	spt->vmas = NULL;
 }
 
 // void copy_hash_elem(struct hash_elem *e, void *aux) {
@@ -318,63 +2124,195 @@ void supplemental_page_table_init(struct supplemental_page_table *spt UNUSED)
 //     memcpy(aux + (uint8_t)p->va, /*src->pages + src->pages의 주소*/, page_size);
 // }
 
+/* Gives the current thread, the child of a fork(), an anonymous
+ * page at SRC's address holding the same contents as SRC, the
+ * parent's.  A resident page shares SRC's frame copy-on-write:
+ * both map it read-only until one of them writes.  A swapped-out
+ * page shares SRC's swap slot instead. */
+static bool
+fork_anon_page(struct page *src)
+{
+	struct page *dst;
+	struct frame *frame;
+	bool ok = true;
+
+	if (!vm_alloc_page(VM_ANON, src->va, src->writable))
+		return false;
+	dst = spt_find_page(&thread_current()->spt, src->va);
+
+	lock_acquire(&frame_lock);
+	page_io_wait(src);
+	ok = anon_fork(dst, src);
+	frame = src->frame;
+	if (ok && frame != NULL && !src->anon.readahead)
+	{
+		/* Write protection is per page, so a huge mapping of
+		 * SRC is split first. */
+		ok = pml4_split_huge_page(src->owner->pml4, src->va);
+		if (ok)
+		{
+			frame_link(frame, dst);
+			pml4_set_writable(src->owner->pml4, src->va, false);
+			ok = pml4_set_page(dst->owner->pml4, dst->va, frame->kva, false);
+			if (!ok)
+				frame_unlink(frame, dst);
+		}
+	}
+	lock_release(&frame_lock);
+	return ok;
+}
+
 /* Copy supplemental page table from src to dst */
 bool supplemental_page_table_copy(struct supplemental_page_table *dst UNUSED,
 								  struct supplemental_page_table *src UNUSED)
 {
 	/* src의 supplemental page table를 반복하면서
 	dst의 supplemental page table의 엔트리의 정확한 복사본을 만드세요 */
-	/* 해시 테이블의 요소 하나하나에 대해 action() 을 임의의 순서로 호출합니다.  */
-	struct hash_iterator spt_iterator, dst_iterator;
-	hash_first (&spt_iterator, &src->pages);
+	/* 주소 순서대로 src의 페이지를 하나씩 방문합니다. */
+	struct page *src_page;
+
+	if (!vma_copy(dst, src))
+		return false;
+	for (src_page = spt_next_page(src, NULL); src_page != NULL;
+		 src_page = spt_next_page(src, src_page->va + PGSIZE)) {
+		/* A page of a VMA that was never loaded, or can be loaded
+		 * again from its file, is made from the child's own VMA on
+		 * its first fault. */
+		struct vma *vma = vma_find(dst, src_page->va);
+		if (vma != NULL && VM_TYPE(src_page->operations->type) != VM_ANON
+			&& (src_page->frame == NULL || file_backed_private(src_page)))
+			continue;
 
-	while (hash_next (&spt_iterator)) {
-		struct page *src_page = hash_entry (hash_cur (&spt_iterator), struct page, hash_elem);
 		if (VM_TYPE(src_page->operations->type) == VM_UNINIT) {
-			vm_alloc_page_with_initializer(src_page->uninit.type, src_page->va, src_page->writable, src_page->uninit.init, src_page->uninit.aux);
+			/* Each page owns its AUX, freed when it is loaded. */
+			struct lazy_load_arg *aux = src_page->uninit.aux;
+			if (aux != NULL) {
+				aux = malloc_tagged(sizeof *aux, MT_MMAP);
+				if (aux == NULL)
+					return false;
+				*aux = *(struct lazy_load_arg *)src_page->uninit.aux;
+			}
+			if (!vm_alloc_page_with_initializer(src_page->uninit.type, src_page->va, src_page->writable, src_page->uninit.init, aux))
+				free(aux);
 			continue;
 		}
 		
-		// vm_claim_page(src_page->va);
-		if (src_page->operations->type == VM_ANON)
-		{
-			vm_alloc_page(src_page->operations->type, src_page->va, src_page->writable);
-			struct page *dst_page = spt_find_page(dst, src_page->va);
-			vm_claim_page(src_page->va);
-			memcpy (dst_page->frame->kva, src_page->frame->kva, (size_t)PGSIZE);
+		if (src_page->operations->type == VM_ANON) {
+			if (!fork_anon_page(src_page))
+				return false;
+			continue;
 		}
-		else if (src_page->operations->type == VM_FILE)
+
+		/* A resident file page gets its own frame, or, if it is
+		 * shared through the page cache, loads it on first touch and
+		 * then finds the parent's frame.  Pin the parent's frame so
+		 * that claiming ours cannot evict it. */
+		bool shared = src_page->operations->type == VM_FILE && src_page->file.shared;
+		lock_acquire(&frame_lock);
+		page_io_wait(src_page);
+		struct frame *src_frame = shared ? NULL : src_page->frame;
+		if (src_frame != NULL)
+			src_frame->pin_cnt++;
+		lock_release(&frame_lock);
+
+		// vm_claim_page(src_page->va);
+		struct lazy_load_arg *aux = NULL;
+		if (src_page->operations->type == VM_FILE)
 		{
-			struct lazy_load_arg *aux = (struct lazy_load_arg*)malloc(sizeof(struct lazy_load_arg));
+			aux = (struct lazy_load_arg*)malloc_tagged(sizeof(struct lazy_load_arg), MT_MMAP);
 			/* src initializer가 호출될 때 file_page 구조체 내에 저장해 둔 file/ofs/read_bytes를 꺼낸다. */
 			/* 같은 파일이 아닌 복제한 파일을 넣어 준다. 자식이 파일을 쓰고 닫아 버리면 접근할 수 없기 때문(?) */
-			aux->file = file_duplicate(src_page->file.file);
+			aux->file = vma != NULL ? vma->file : file_duplicate(src_page->file.file);
 			aux->ofs = src_page->file.file_ofs;
 			aux->read_bytes = src_page->file.read_bytes;
 			aux->zero_bytes = src_page->file.zero_bytes;
-
-			vm_alloc_page_with_initializer(src_page->operations->type, src_page->va, src_page->writable, NULL, aux);
-			struct page *dst_page = spt_find_page(dst, src_page->va);
-
-			/* dst_page의 경우 프레임 할당받지 않기 때문에, initializer가 호출되지 않는다. 따라서 직접 initializer를 호출 */
-			file_backed_initializer(dst_page, VM_FILE, NULL);
-			dst_page->frame = src_page->frame;
-			pml4_set_page(thread_current()->pml4, dst_page->va, src_page->frame->kva, src_page->writable);
 		}
+		bool ok = vm_alloc_page_with_initializer(src_page->operations->type | (shared ? VM_FILE_SHARED : 0),
+												 src_page->va, src_page->writable,
+												 src_frame != NULL ? NULL : lazy_load_segment, aux);
+		if (!ok)
+			free(aux);
+		struct page *dst_page = spt_find_page(dst, src_page->va);
+		if (ok && src_frame != NULL)
+		{
+			ok = vm_claim_page(src_page->va);
+			if (ok)
+				memcpy (dst_page->frame->kva, src_frame->kva, (size_t)PGSIZE);
+		}
+		if (src_frame != NULL)
+		{
+			lock_acquire(&frame_lock);
+			src_frame->pin_cnt--;
+			lock_release(&frame_lock);
+		}
+		if (!ok)
+			return false;
 	}
 	return true;
 }
 
-void destroy_hash_elem(struct hash_elem *e, void *aux) {
-	struct page *p = hash_entry(e, struct page, hash_elem);
-    destroy(p);
+/* Destroys page P of the address space being torn down, whose
+ * unmaps TLB gathers.  The frame is released here rather than by
+ * pml4_destroy(), which only sees pages that are still mapped. */
+static void
+spt_destroy_page(struct page *p, struct tlb_gather *tlb)
+{
+	lock_acquire(&frame_lock);
+	page_writeback(p);
+	destroy(p);
+	if (p->frame != NULL)
+	{
+		struct frame *frame = p->frame;
+
+		fa_account(p, pml4_is_accessed(p->owner->pml4, p->va));
+		pml4_clear_page_gather(tlb, p->va);
+		frame_unlink(frame, p);
+		if (frame->ref_cnt == 0 && frame != &zero_frame)
+			frame_release(frame);
+	}
+	lock_release(&frame_lock);
 	free(p);
 }
 
+/* Destroys every page under NODE, of level LEVEL, and frees the
+ * nodes below it.  A slot is cleared only once what it points to
+ * is gone, so lookups made while destroying a page still work. */
+static void
+spt_destroy(struct spt_node *node, int level, struct tlb_gather *tlb)
+{
+	for (size_t i = 0; i < SPT_FANOUT; i++)
+	{
+		void *slot = node->slots[i];
+
+		if (slot == NULL)
+			continue;
+		if (level == SPT_LEVELS - 1)
+			spt_destroy_page(slot, tlb);
+		else
+		{
+			spt_destroy(slot, level + 1, tlb);
+			free(slot);
+		}
+		node->slots[i] = NULL;
+	}
+}
+
 /* Free the resource hold by the supplemental page table */
 void supplemental_page_table_kill(struct supplemental_page_table *spt UNUSED)
 {
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
-	hash_clear(&spt->pages, destroy_hash_elem);
+	struct tlb_gather tlb;
+
+	/* The whole address space goes away right after this, so the
+	 * unmaps need no TLB invalidation at all. */
+	tlb_gather_init(&tlb, thread_current()->pml4, true);
+	if (spt->root != NULL)
+	{
+		spt_destroy(spt->root, 0, &tlb);
+		free(spt->root);
+		spt->root = NULL;
+	}
+	tlb_gather_finish(&tlb);
+	vma_destroy(spt);
 }
@@ -0,0 +1,297 @@
+/* vma.c: Virtual memory areas.
+ *
+ * A process's VMAs are kept in an interval tree in its supplemental
+ * page table.  VMAs never overlap, so ordering them by start address
+ * orders them by end address too, and a plain search tree keyed by
+ * START answers both "which VMA holds this address" and "does this
+ * range overlap any VMA".  The tree is an AVL tree, so both take
+ * O(log n) whatever the order of mmap() and munmap() calls.
+ *
+ * Mapping a region only adds its VMA; no page is created until the
+ * first fault in it, which calls vma_get_page(). */
+
+#include "vm/vma.h"
+#include <mman.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#include "vm/vm.h"
+
+static int
+height (const struct vma *v) {
+	return v != NULL ? v->height : 0;
+}
+
+static void
+update (struct vma *v) {
+	int l = height (v->left), r = height (v->right);
+
+	v->height = (l > r ? l : r) + 1;
+}
+
+static struct vma *
+rotate_right (struct vma *v) {
+	struct vma *l = v->left;
+
+	v->left = l->right;
+	l->right = v;
+	update (v);
+	update (l);
+	return l;
+}
+
+static struct vma *
+rotate_left (struct vma *v) {
+	struct vma *r = v->right;
+
+	v->right = r->left;
+	r->left = v;
+	update (v);
+	update (r);
+	return r;
+}
+
+/* Restores the AVL balance of the subtree rooted at V, whose
+ * children are balanced, and returns its new root. */
+static struct vma *
+balance (struct vma *v) {
+	int diff = height (v->left) - height (v->right);
+
+	update (v);
+	if (diff > 1) {
+		if (height (v->left->left) < height (v->left->right))
+			v->left = rotate_left (v->left);
+		return rotate_right (v);
+	}
+	if (diff < -1) {
+		if (height (v->right->right) < height (v->right->left))
+			v->right = rotate_right (v->right);
+		return rotate_left (v);
+	}
+	return v;
+}
+
+static struct vma *
+tree_insert (struct vma *root, struct vma *v) {
+	if (root == NULL)
+		return v;
+	if (v->start < root->start)
+		root->left = tree_insert (root->left, v);
+	else
+		root->right = tree_insert (root->right, v);
+	return balance (root);
+}
+
+/* Removes the leftmost node of ROOT, storing it in *MIN. */
+static struct vma *
+remove_min (struct vma *root, struct vma **min) {
+	if (root->left == NULL) {
+		*min = root;
+		return root->right;
+	}
+	root->left = remove_min (root->left, min);
+	return balance (root);
+}
+
+static struct vma *
+tree_remove (struct vma *root, struct vma *v) {
+	ASSERT (root != NULL);
+
+	if (v->start < root->start)
+		root->left = tree_remove (root->left, v);
+	else if (v->start > root->start)
+		root->right = tree_remove (root->right, v);
+	else {
+		struct vma *min;
+
+		if (root->right == NULL)
+			return root->left;
+		root->right = remove_min (root->right, &min);
+		min->left = root->left;
+		min->right = root->right;
+		root = min;
+	}
+	return balance (root);
+}
+
+/* Maps LENGTH bytes at START, which is page-aligned, as pages of
+ * TYPE, the first READ_BYTES bytes read from FILE at OFS and the
+ * rest zeroed; FILE may be NULL if READ_BYTES is 0.  The VMA keeps
+ * its own reopened FILE.  Fails if the range is not in user space
+ * or overlaps a VMA or a page already in SPT. */
+bool
+vma_map (struct supplemental_page_table *spt, void *start, size_t length,
+		enum vm_type type, bool writable, struct file *file, off_t ofs,
+		size_t read_bytes) {
+	struct vma *v;
+	void *end = start + ROUND_UP (length, PGSIZE);
+	struct page *p;
+
+	ASSERT (pg_ofs (start) == 0);
+	ASSERT (read_bytes <= length);
+
+	if (length == 0 || end <= start || !is_user_vaddr (end - 1)
+			|| vma_overlaps (spt, start, end))
+		return false;
+	p = spt_next_page (spt, start);
+	if (p != NULL && p->va < end)
+		return false;
+
+	v = malloc_tagged (sizeof *v, MT_MMAP);
+	if (v == NULL)
+		return false;
+	*v = (struct vma) {
+		.start = start,
+		.end = end,
+		.type = type,
+		.writable = writable,
+		.ofs = ofs,
+		.read_bytes = read_bytes,
+		.advice = MADV_NORMAL,
+		.height = 1,
+	};
+	if (file != NULL && (v->file = file_reopen (file)) == NULL) {
+		free (v);
+		return false;
+	}
+	spt->vmas = tree_insert (spt->vmas, v);
+	return true;
+}
+
+/* Removes VMA from SPT and frees it.  Its pages must be gone. */
+void
+vma_unmap (struct supplemental_page_table *spt, struct vma *vma) {
+	spt->vmas = tree_remove (spt->vmas, vma);
+	file_close (vma->file);
+	free (vma);
+}
+
+/* Returns the VMA of SPT that holds VA, or NULL. */
+struct vma *
+vma_find (struct supplemental_page_table *spt, void *va) {
+	struct vma *v = spt->vmas;
+
+	while (v != NULL) {
+		if (va < v->start)
+			v = v->left;
+		else if (va >= v->end)
+			v = v->right;
+		else
+			return v;
+	}
+	return NULL;
+}
+
+/* Returns true if [START, END) overlaps a VMA of SPT. */
+bool
+vma_overlaps (struct supplemental_page_table *spt, void *start, void *end) {
+	struct vma *v = spt->vmas;
+
+	while (v != NULL) {
+		if (end <= v->start)
+			v = v->left;
+		else if (start >= v->end)
+			v = v->right;
+		else
+			return true;
+	}
+	return false;
+}
+
+/* Returns the page at VA in SPT, which must be the current thread's,
+ * creating it from the VMA that holds VA if there is none yet.
+ * Returns NULL if VA is not mapped. */
+struct page *
+vma_get_page (struct supplemental_page_table *spt, void *va) {
+	struct page *page = spt_find_page (spt, va);
+	struct lazy_load_arg *aux;
+	struct vma *v;
+	size_t ofs;
+
+	ASSERT (spt == &thread_current ()->spt);
+
+	if (page != NULL || (v = vma_find (spt, va)) == NULL)
+		return page;
+
+	va = pg_round_down (va);
+	ofs = (uint8_t *) va - (uint8_t *) v->start;
+	aux = NULL;
+	if (v->file != NULL) {
+		aux = malloc_tagged (sizeof *aux, MT_MMAP);
+		if (aux == NULL)
+			return NULL;
+		aux->file = v->file;
+		aux->ofs = v->ofs + ofs;
+		aux->read_bytes = v->read_bytes > ofs
+			? (v->read_bytes - ofs < PGSIZE ? v->read_bytes - ofs : PGSIZE)
+			: 0;
+		aux->zero_bytes = PGSIZE - aux->read_bytes;
+	}
+	if (!vm_alloc_page_with_initializer (v->type, va, v->writable,
+				aux != NULL ? lazy_load_segment : NULL, aux)) {
+		free (aux);
+		return NULL;
+	}
+	return spt_find_page (spt, va);
+}
+
+/* Returns the madvise() advice in effect for PAGE. */
+int
+vma_advice (struct page *page) {
+	struct vma *v = vma_find (&page->owner->spt, page->va);
+
+	return v != NULL ? v->advice : MADV_NORMAL;
+}
+
+static struct vma *
+clone (struct vma *v, bool *ok) {
+	struct vma *c;
+
+	if (v == NULL || !*ok)
+		return NULL;
+	c = malloc_tagged (sizeof *c, MT_MMAP);
+	if (c == NULL) {
+		*ok = false;
+		return NULL;
+	}
+	*c = *v;
+	c->file = NULL;
+	if (v->file != NULL && (c->file = file_reopen (v->file)) == NULL)
+		*ok = false;
+	c->left = clone (v->left, ok);
+	c->right = clone (v->right, ok);
+	return c;
+}
+
+/* Gives DST, which has no VMAs, a copy of every VMA of SRC, for
+ * fork().  Returns false if memory runs out; DST's VMAs are then
+ * freed by vma_destroy() as usual. */
+bool
+vma_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	bool ok = true;
+
+	ASSERT (dst->vmas == NULL);
+	dst->vmas = clone (src->vmas, &ok);
+	return ok;
+}
+
+static void
+destroy_tree (struct vma *v) {
+	if (v == NULL)
+		return;
+	destroy_tree (v->left);
+	destroy_tree (v->right);
+	file_close (v->file);
+	free (v);
+}
+
+/* Frees every VMA of SPT.  Their pages must be gone. */
+void
+vma_destroy (struct supplemental_page_table *spt) {
+	destroy_tree (spt->vmas);
+	spt->vmas = NULL;
+}
@@ -0,0 +1,371 @@
+/* zswap.c: Compressed in-memory tier in front of the swap disk.
+ *
+ * An evicted anonymous page is first compressed into a pool in
+ * kernel memory; only pages that do not compress well, or that
+ * the pool has no room for, go to the swap disk.  A swap-in that
+ * finds its page in the pool decompresses it, which is far cheaper
+ * than programmed I/O.  When the pool is full, its least recently
+ * stored pages are written back to the swap disk to make room.
+ * The writes are made with no lock held: an entry being written
+ * back leaves the LRU but stays in the pool, so that a swap-in
+ * can still find it, until the write is done. */
+
+#include "vm/zswap.h"
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+/* A compressed page. */
+struct zswap_entry {
+	struct list_elem lru_elem;  /* Element in LRU, unless WRITING. */
+	bool writing;               /* Being written back to disk. */
+	struct page *page;          /* Swapped-out page it holds, NULL if
+	                               it went while WRITING. */
+	size_t len;                 /* Bytes in DATA. */
+	uint8_t data[];             /* Compressed contents. */
+};
+
+/* A page that does not compress to this size goes to disk. */
+#define ZSWAP_MAX_LEN (PGSIZE * 3 / 4)
+
+size_t zswap_pool_limit = SIZE_MAX;
+
+static size_t pool_max;         /* Pool limit in bytes. */
+static size_t pool_bytes;       /* Bytes allocated to entries. */
+static size_t stored_cnt;       /* Entries in the pool. */
+static struct list lru;         /* Entries, least recently stored first. */
+static struct lock zswap_lock;  /* Protects all of the above, the
+                                   buffers below, and the ZENTRY of
+                                   every anonymous page. */
+
+/* Statistics. */
+static long long store_cnt;     /* Pages stored. */
+static long long reject_cnt;    /* Pages that compressed poorly. */
+static long long writeback_cnt; /* Pages written back to disk. */
+static long long hit_cnt;       /* Swap-ins served from the pool. */
+static long long miss_cnt;      /* Swap-ins that read the disk. */
+
+/* Compressor.  A simple LZ77 variant in the spirit of LZ4: the
+ * output is a sequence of literal runs, a tag byte 0LLLLLLL and
+ * L + 1 bytes copied verbatim, and matches, a tag byte 1MMMMMMM
+ * and a 16-bit little-endian distance, repeating M + LZ_MIN_MATCH
+ * bytes from that far back.  Matches are found through a hash of
+ * the next four bytes, remembering only the last position of
+ * each hash, which is fast and good enough for the zero-filled
+ * and repetitive pages that dominate in practice. */
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 127)
+#define LZ_MAX_LITERAL 128
+#define LZ_HASH_BITS 12
+#define LZ_NO_POS UINT16_MAX
+
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+static uint8_t lz_buf[ZSWAP_MAX_LEN];   /* Compressor output. */
+
+static uint32_t
+lz_read32 (const uint8_t *p) {
+	uint32_t v;
+
+	memcpy (&v, p, sizeof v);
+	return v;
+}
+
+/* Appends CNT literal bytes from SRC to DST, which holds *OUT of
+ * at most MAX bytes.  Returns false if they do not fit. */
+static bool
+lz_literals (const uint8_t *src, size_t cnt, uint8_t *dst, size_t *out,
+		size_t max) {
+	while (cnt > 0) {
+		size_t run = cnt < LZ_MAX_LITERAL ? cnt : LZ_MAX_LITERAL;
+
+		if (*out + 1 + run > max)
+			return false;
+		dst[(*out)++] = run - 1;
+		memcpy (dst + *out, src, run);
+		*out += run;
+		src += run;
+		cnt -= run;
+	}
+	return true;
+}
+
+/* Compresses the page at SRC into DST, of MAX bytes.  Returns the
+ * compressed length, or 0 if it would exceed MAX. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t max) {
+	size_t ip = 0, lit = 0, out = 0;
+
+	memset (lz_table, 0xff, sizeof lz_table);
+	while (ip + LZ_MIN_MATCH <= PGSIZE) {
+		uint32_t seq = lz_read32 (src + ip);
+		size_t h = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+		size_t cand = lz_table[h];
+		size_t len = LZ_MIN_MATCH;
+
+		lz_table[h] = ip;
+		if (cand == LZ_NO_POS || lz_read32 (src + cand) != seq) {
+			ip++;
+			continue;
+		}
+		while (ip + len < PGSIZE && len < LZ_MAX_MATCH
+				&& src[cand + len] == src[ip + len])
+			len++;
+
+		if (!lz_literals (src + lit, ip - lit, dst, &out, max)
+				|| out + 3 > max)
+			return 0;
+		dst[out++] = 0x80 | (len - LZ_MIN_MATCH);
+		dst[out++] = (ip - cand) & 0xff;
+		dst[out++] = (ip - cand) >> 8;
+		ip += len;
+		lit = ip;
+	}
+	if (!lz_literals (src + lit, PGSIZE - lit, dst, &out, max))
+		return 0;
+	return out;
+}
+
+/* Decompresses the LEN bytes at SRC into the page at DST. */
+static void
+lz_decompress (const uint8_t *src, size_t len, uint8_t *dst) {
+	size_t ip = 0, out = 0;
+
+	while (ip < len) {
+		uint8_t tag = src[ip++];
+
+		if (tag & 0x80) {
+			size_t cnt = (tag & 0x7f) + LZ_MIN_MATCH;
+			size_t dist = src[ip] | (src[ip + 1] << 8);
+
+			ip += 2;
+			ASSERT (dist > 0 && dist <= out && out + cnt <= PGSIZE);
+			/* Byte by byte: the source may overlap the output. */
+			for (; cnt > 0; cnt--, out++)
+				dst[out] = dst[out - dist];
+		} else {
+			size_t cnt = tag + 1;
+
+			ASSERT (out + cnt <= PGSIZE);
+			memcpy (dst + out, src + ip, cnt);
+			ip += cnt;
+			out += cnt;
+		}
+	}
+	ASSERT (out == PGSIZE);
+}
+
+/* Sets up the pool. */
+void
+zswap_init (void) {
+	size_t user_pages;
+
+	palloc_user_pool (&user_pages);
+	if (zswap_pool_limit == SIZE_MAX)
+		zswap_pool_limit = user_pages / 4;
+	pool_max = zswap_pool_limit * PGSIZE;
+	list_init (&lru);
+	lock_init (&zswap_lock);
+}
+
+/* Removes entry E from the pool and frees it, detaching it from
+ * its page.  An entry being written back is only detached; the
+ * writer frees it.  ZSWAP_LOCK must be held. */
+static void
+entry_free (struct zswap_entry *e) {
+	e->page->anon.zentry = NULL;
+	if (e->writing) {
+		e->page = NULL;
+		return;
+	}
+	list_remove (&e->lru_elem);
+	pool_bytes -= sizeof *e + e->len;
+	stored_cnt--;
+	free (e);
+}
+
+/* Writes the least recently stored entry back to the swap disk
+ * and frees it, giving its page the slot written, unless the page
+ * was swapped in or freed meanwhile.  Returns false if the disk
+ * has no room or memory runs out.  ZSWAP_LOCK and the frame table
+ * lock must be held; both are dropped for the write. */
+static bool
+writeback_oldest (void) {
+	struct zswap_entry *e = list_entry (list_pop_front (&lru),
+			struct zswap_entry, lru_elem);
+	uint8_t *buf = palloc_get_page (0);
+	size_t slot;
+	bool ok;
+
+	if (buf == NULL) {
+		list_push_front (&lru, &e->lru_elem);
+		return false;
+	}
+	e->writing = true;
+	lz_decompress (e->data, e->len, buf);
+	lock_release (&zswap_lock);
+	ok = anon_swap_write (buf, &slot);
+	lock_acquire (&zswap_lock);
+	palloc_free_page (buf);
+	e->writing = false;
+
+	if (e->page == NULL) {
+		if (ok)
+			anon_swap_attach (NULL, slot);
+	} else if (ok) {
+		anon_swap_attach (e->page, slot);
+		e->page->anon.zentry = NULL;
+		writeback_cnt++;
+	} else {
+		list_push_front (&lru, &e->lru_elem);
+		return false;
+	}
+	pool_bytes -= sizeof *e + e->len;
+	stored_cnt--;
+	free (e);
+	return true;
+}
+
+/* Makes room for an entry of SIZE bytes, writing back old entries
+ * as needed.  Returns false if that is impossible.  ZSWAP_LOCK
+ * and the frame table lock must be held; see writeback_oldest(). */
+static bool
+make_room (size_t size) {
+	if (size > pool_max)
+		return false;
+	while (pool_bytes + size > pool_max)
+		if (list_empty (&lru) || !writeback_oldest ())
+			return false;
+	return true;
+}
+
+/* Adds an entry holding the LEN compressed bytes at DATA to the
+ * pool for PAGE.  Returns false if there is no room.  ZSWAP_LOCK
+ * and the frame table lock must be held.  DATA is copied before
+ * making room, which may drop the locks. */
+static bool
+entry_add (struct page *page, const uint8_t *data, size_t len) {
+	struct zswap_entry *e;
+
+	e = malloc_tagged (sizeof *e + len, MT_VM_SWAP);
+	if (e == NULL)
+		return false;
+	e->writing = false;
+	e->page = page;
+	e->len = len;
+	memcpy (e->data, data, len);
+	if (!make_room (sizeof *e + len)) {
+		free (e);
+		return false;
+	}
+	list_push_back (&lru, &e->lru_elem);
+	pool_bytes += sizeof *e + len;
+	stored_cnt++;
+	page->anon.zentry = e;
+	return true;
+}
+
+/* Compresses the contents of PAGE, an anonymous page being swapped
+ * out, from KVA into the pool.  Returns false if the page should
+ * go to disk instead.  The frame table lock must be held. */
+bool
+zswap_store (struct page *page, const void *kva) {
+	size_t len;
+	bool ok = false;
+
+	ASSERT (page->anon.zentry == NULL);
+
+	if (pool_max == 0)
+		return false;
+	lock_acquire (&zswap_lock);
+	len = lz_compress (kva, lz_buf, sizeof lz_buf);
+	if (len == 0)
+		reject_cnt++;
+	else if (entry_add (page, lz_buf, len)) {
+		store_cnt++;
+		ok = true;
+	}
+	lock_release (&zswap_lock);
+	return ok;
+}
+
+/* If PAGE is in the pool, decompresses it into KVA, removes it
+ * from the pool and returns true.  Otherwise returns false, and
+ * the page must be read from its swap slot: it may have been
+ * written back just now. */
+bool
+zswap_load (struct page *page, void *kva) {
+	struct zswap_entry *e;
+
+	lock_acquire (&zswap_lock);
+	e = page->anon.zentry;
+	if (e != NULL) {
+		lz_decompress (e->data, e->len, kva);
+		entry_free (e);
+		hit_cnt++;
+	}
+	lock_release (&zswap_lock);
+	return e != NULL;
+}
+
+/* Gives DST, a fork() child's page, a copy of the pool entry of
+ * SRC, the parent's page.  Returns false if the pool has no room.
+ * The frame table lock must be held. */
+bool
+zswap_dup (struct page *dst, struct page *src) {
+	struct zswap_entry *e;
+	size_t len;
+	bool ok;
+
+	lock_acquire (&zswap_lock);
+	e = src->anon.zentry;
+	ASSERT (e != NULL);
+	/* Making room may write back SRC's own entry. */
+	len = e->len;
+	memcpy (lz_buf, e->data, len);
+	ok = entry_add (dst, lz_buf, len);
+	lock_release (&zswap_lock);
+	return ok;
+}
+
+/* Drops PAGE's entry from the pool, if it has one. */
+void
+zswap_free (struct page *page) {
+	lock_acquire (&zswap_lock);
+	if (page->anon.zentry != NULL)
+		entry_free (page->anon.zentry);
+	lock_release (&zswap_lock);
+}
+
+/* Counts a swap-in that had to read the disk. */
+void
+zswap_miss (void) {
+	lock_acquire (&zswap_lock);
+	miss_cnt++;
+	lock_release (&zswap_lock);
+}
+
+/* Prints zswap statistics. */
+void
+zswap_print_stats (void) {
+	long long loads = hit_cnt + miss_cnt;
+
+	if (pool_max == 0)
+		return;
+	printf ("Zswap: %lld stores, %lld rejected, %lld written back, "
+			"%lld of %lld swap-ins hit (%lld%%)\n",
+			store_cnt, reject_cnt, writeback_cnt, hit_cnt, loads,
+			loads > 0 ? hit_cnt * 100 / loads : 0);
+	printf ("Zswap: %zu pages in %zu of %zu bytes",
+			stored_cnt, pool_bytes, pool_max);
+	if (pool_bytes > 0)
+		printf (", compression ratio %zu.%02zu",
+				stored_cnt * PGSIZE / pool_bytes,
+				stored_cnt * PGSIZE * 100 / pool_bytes % 100);
+	printf ("\n");
+}